@@ -0,0 +1,2 @@
+cmake ../
+make -j
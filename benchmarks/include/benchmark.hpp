@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ *  File:   benchmark.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Minimal benchmark registry and reporting helpers for the
+ *              `dien` benchmarks.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace dien
+{
+namespace bench
+{
+
+struct Benchmark
+{
+  std::string name;
+  std::function<void()> body;
+};
+
+inline std::vector<Benchmark>& Registry()
+{
+  static std::vector<Benchmark> registry;
+  return registry;
+}
+
+struct Registrar
+{
+  Registrar(const char* name, void (*body)())
+  {
+    Registry().push_back(Benchmark{name, body});
+  }
+};
+
+// Wall clock stopwatch.
+class Stopwatch
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  Stopwatch() : start_(Clock::now())
+  {
+  }
+
+  void Reset()
+  {
+    start_ = Clock::now();
+  }
+
+  double ElapsedNanos() const
+  {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start_)
+        .count();
+  }
+
+  double ElapsedSeconds() const
+  {
+    return ElapsedNanos() / 1e9;
+  }
+
+ private:
+  Clock::time_point start_;
+};  // class Stopwatch
+
+// Prints one result row: `<benchmark> <case> <value> <unit>`.
+inline void Report(const std::string& benchmark, const std::string& label,
+                   double value, const char* unit)
+{
+  std::printf("%-28s %-44s %14.2f %s\n", benchmark.c_str(), label.c_str(),
+              value, unit);
+  std::fflush(stdout);
+}
+
+// Keeps the optimizer from discarding `value`.
+template <class T>
+inline void DoNotOptimize(T const& value)
+{
+  asm volatile("" : : "g"(value) : "memory");
+}
+
+}  // namespace bench
+}  // namespace dien
+
+#define DIEN_BENCHMARK(name)                                       \
+  static void name();                                              \
+  static ::dien::bench::Registrar name##_registrar(#name, &name); \
+  static void name()
@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ *  File:   perf_counter.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Hardware event counter for the calling thread, read through
+ *              Linux `perf_event_open`.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+
+namespace dien
+{
+namespace bench
+{
+
+// Counts one hardware event (cache misses by default) for this thread while
+// started. Unavailable without PMU access, e.g. in most containers or with
+// a restrictive `perf_event_paranoid`; check `Valid()`.
+class PerfCounter
+{
+ public:
+  explicit PerfCounter(uint64_t event = PERF_COUNT_HW_CACHE_MISSES)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  PerfCounter(const PerfCounter&) = delete;
+  PerfCounter& operator=(const PerfCounter&) = delete;
+
+  ~PerfCounter()
+  {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool Valid() const
+  {
+    return fd_ >= 0;
+  }
+
+  void Start()
+  {
+    if (Valid()) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  // Events counted since `Start()`.
+  uint64_t Stop()
+  {
+    uint64_t count = 0;
+    if (Valid()) {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+
+    return count;
+  }
+
+ private:
+  int fd_;
+};  // class PerfCounter
+
+}  // namespace bench
+}  // namespace dien
@@ -0,0 +1,144 @@
+/******************************************************************************
+ *
+ *  File:   allocator_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Multi-threaded create/fulfil/destroy of Promise/Future pairs
+ *              with pooled and plain heap `SharedData` allocation.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "future.hpp"
+#include "scoped_lock.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+const int kIterations = 200000;
+const size_t kBatch = 256;
+
+// Every thread creates, fulfils and destroys its own pairs.
+double SameThread(unsigned threads)
+{
+  Stopwatch watch;
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back([]() {
+      for (int i = 0; i < kIterations; i++) {
+        Promise<int> promise;
+        Future<int> f = promise.GetFuture();
+        promise.SetValue(i);
+        DoNotOptimize(f.Value());
+      }
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  return watch.ElapsedNanos() / (static_cast<double>(threads) * kIterations);
+}
+
+// Producers create pairs and hand the promises to a consumer thread that
+// fulfils and destroys them, so every node is freed by a foreign thread.
+double CrossThread(unsigned producers)
+{
+  SpinLock<> lock;
+  std::vector<std::vector<Promise<int>>> batches;
+  std::atomic<unsigned> done(0);
+
+  Stopwatch watch;
+
+  std::thread consumer([&]() {
+    std::vector<std::vector<Promise<int>>> taken;
+    for (;;) {
+      {
+        ScopedLock<> guard(lock);
+        taken.swap(batches);
+      }
+
+      if (taken.empty()) {
+        if (done.load() == producers) {
+          ScopedLock<> guard(lock);
+          if (batches.empty()) {
+            break;
+          }
+        }
+        std::this_thread::yield();
+        continue;
+      }
+
+      for (auto& batch : taken) {
+        for (auto& promise : batch) {
+          promise.SetValue(1);
+        }
+      }
+      taken.clear();
+    }
+  });
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < producers; t++) {
+    workers.emplace_back([&]() {
+      std::vector<Promise<int>> batch;
+      for (int i = 0; i < kIterations; i++) {
+        batch.emplace_back();
+        batch.back().GetFuture();
+
+        if (batch.size() == kBatch || i + 1 == kIterations) {
+          ScopedLock<> guard(lock);
+          batches.push_back(std::move(batch));
+          batch.clear();
+        }
+      }
+      done++;
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  consumer.join();
+
+  return watch.ElapsedNanos() / (static_cast<double>(producers) * kIterations);
+}
+
+void Run(const char* allocator_name, BlockAllocator* allocator)
+{
+  BlockAllocator* previous = SetBlockAllocator(allocator);
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  for (unsigned threads = 1; threads <= cores; threads *= 2) {
+    std::string suffix = std::string(" ") + std::to_string(threads) +
+                         " threads " + allocator_name;
+
+    Report("SharedDataAllocation", "same thread" + suffix, SameThread(threads),
+           "ns/pair");
+    Report("SharedDataAllocation", "cross thread" + suffix,
+           CrossThread(threads), "ns/pair");
+  }
+
+  SetBlockAllocator(previous);
+}
+
+}  // namespace
+
+DIEN_BENCHMARK(SharedDataAllocation)
+{
+  Run("malloc", &MallocAllocator::Instance());
+  Run("pool", nullptr);
+}
@@ -0,0 +1,221 @@
+/******************************************************************************
+ *
+ *  File:   collect_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Cost of joining 10, 1k and 100k futures with `CollectAll`
+ *              against a hand-rolled join with one `Then` per input, and of
+ *              folding 100k results with `Reduce` and `UnorderedReduce`
+ *              against collecting them first.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocation_counter.hpp"
+#include "benchmark.hpp"
+#include "collect.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+using namespace dien::test;
+
+namespace
+{
+
+const size_t kFuturesPerSize = 1000000;
+const size_t kReduceInputs = 100000;
+const int kReduceRounds = 10;
+
+// The join as written before `CollectAll`: every input gets its own `Then`,
+// and so its own Promise, that stores the value and counts down.
+Future<std::vector<int>> ThenJoin(std::vector<Future<int>>& futures,
+                                  std::vector<Future<void>>& links)
+{
+  struct Join
+  {
+    explicit Join(size_t n) : values(n), remaining(n)
+    {
+    }
+
+    Promise<std::vector<int>> promise;
+    std::vector<int> values;
+    std::atomic<size_t> remaining;
+  };
+
+  Join* join = new Join(futures.size());
+  Future<std::vector<int>> f = join->promise.GetFuture();
+
+  for (size_t i = 0; i < futures.size(); i++) {
+    links.push_back(futures[i].Then([join, i](int v) {
+      join->values[i] = v;
+      if (join->remaining.fetch_sub(1) == 1) {
+        join->promise.SetValue(std::move(join->values));
+        delete join;
+      }
+    }));
+  }
+
+  return f;
+}
+
+void Run(size_t n)
+{
+  size_t rounds = kFuturesPerSize / n;
+  std::string size = std::to_string(n);
+
+  std::vector<Promise<int>> promises;
+  std::vector<Future<int>> futures;
+  std::vector<Future<void>> links;
+  futures.reserve(n);
+  links.reserve(n);
+
+  size_t collect_allocations = 0;
+  size_t then_allocations = 0;
+  double collect_nanos = 0;
+  double then_nanos = 0;
+
+  // Round 0 counts every allocation, rather than pool refills; the rest are
+  // timed with the default pools.
+  for (size_t round = 0; round <= rounds; round++) {
+    bool counting = round == 0;
+    SetBlockAllocator(counting ? &MallocAllocator::Instance() : nullptr);
+
+    for (int variant = 0; variant < 2; variant++) {
+      promises = std::vector<Promise<int>>(n);
+      for (auto& promise : promises) {
+        futures.push_back(promise.GetFuture());
+      }
+
+      AllocationCounter counter;
+      Stopwatch watch;
+
+      if (variant == 0) {
+        Future<std::vector<Try<int>>> all =
+            CollectAll(futures.begin(), futures.end());
+        for (size_t i = 0; i < n; i++) {
+          promises[i].SetValue(static_cast<int>(i));
+        }
+        DoNotOptimize(all.Value().back());
+
+        if (counting) {
+          collect_allocations = counter.Count();
+        } else {
+          collect_nanos += watch.ElapsedNanos();
+        }
+      } else {
+        Future<std::vector<int>> all = ThenJoin(futures, links);
+        for (size_t i = 0; i < n; i++) {
+          promises[i].SetValue(static_cast<int>(i));
+        }
+        DoNotOptimize(all.Value().back());
+
+        if (counting) {
+          then_allocations = counter.Count();
+        } else {
+          then_nanos += watch.ElapsedNanos();
+        }
+      }
+
+      futures.clear();
+      links.clear();
+    }
+  }
+
+  Report("CollectAllJoin", "CollectAll " + size + " time",
+         collect_nanos / (rounds * n), "ns/future");
+  Report("CollectAllJoin", "CollectAll " + size + " allocations",
+         collect_allocations, "allocs/join");
+  Report("CollectAllJoin", "Then per input " + size + " time",
+         then_nanos / (rounds * n), "ns/future");
+  Report("CollectAllJoin", "Then per input " + size + " allocations",
+         then_allocations, "allocs/join");
+}
+
+// 0: CollectAll then fold, 1: Reduce, 2: UnorderedReduce. Inputs complete
+// in reverse order, the worst case for an in-order fold.
+long Fold(int variant, std::vector<Promise<long>>& promises,
+          std::vector<Future<long>>& futures)
+{
+  auto add = [](long&& sum, long v) { return sum + v; };
+
+  Future<long> sum(0L);
+  if (variant == 0) {
+    sum = CollectAll(futures.begin(), futures.end())
+              .Then([](std::vector<Try<long>> all) {
+                long s = 0;
+                for (auto& t : all) {
+                  s += t.Value();
+                }
+                return s;
+              });
+  } else if (variant == 1) {
+    sum = Reduce(futures.begin(), futures.end(), 0L, add);
+  } else {
+    sum = UnorderedReduce(futures.begin(), futures.end(), 0L, add);
+  }
+
+  for (size_t i = promises.size(); i-- > 0;) {
+    promises[i].SetValue(static_cast<long>(i));
+  }
+
+  return sum.Value();
+}
+
+}  // namespace
+
+// Memory held while the inputs are outstanding: CollectAll a Try per input,
+// Reduce a slot per input, UnorderedReduce one accumulator.
+DIEN_BENCHMARK(ReduceFold)
+{
+  const char* labels[] = {"CollectAll then fold", "Reduce",
+                          "UnorderedReduce"};
+
+  std::vector<Promise<long>> promises;
+  std::vector<Future<long>> futures;
+  futures.reserve(kReduceInputs);
+
+  for (int variant = 0; variant < 3; variant++) {
+    size_t allocations = 0;
+    double nanos = 0;
+
+    for (int round = 0; round <= kReduceRounds; round++) {
+      bool counting = round == 0;
+      SetBlockAllocator(counting ? &MallocAllocator::Instance() : nullptr);
+
+      promises = std::vector<Promise<long>>(kReduceInputs);
+      futures.clear();
+      for (auto& promise : promises) {
+        futures.push_back(promise.GetFuture());
+      }
+
+      AllocationCounter counter;
+      Stopwatch watch;
+      DoNotOptimize(Fold(variant, promises, futures));
+
+      if (counting) {
+        allocations = counter.Count();
+      } else {
+        nanos += watch.ElapsedNanos();
+      }
+    }
+
+    Report("ReduceFold", std::string(labels[variant]) + " time",
+           nanos / (kReduceRounds * kReduceInputs), "ns/input");
+    Report("ReduceFold", std::string(labels[variant]) + " allocations",
+           allocations, "allocs/fold");
+  }
+
+  SetBlockAllocator(nullptr);
+}
+
+DIEN_BENCHMARK(CollectAllJoin)
+{
+  Run(10);
+  Run(1000);
+  Run(100000);
+}
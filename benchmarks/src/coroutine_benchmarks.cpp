@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ *  File:   coroutine_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: A sequence of dependent asynchronous steps written as a
+ *              `Task` awaiting each step against the same sequence as a
+ *              chain of future-returning `Then`s. Empty unless built with
+ *              coroutine support.
+ *
+ ******************************************************************************/
+
+#include "coroutine.hpp"
+
+#if DIEN_HAS_COROUTINES
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocation_counter.hpp"
+#include "benchmark.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+using namespace dien::test;
+
+namespace
+{
+
+const int kSteps = 16;
+const int kRounds = 20000;
+
+// An asynchronous step, fulfilled later by `Drain`: each one costs the
+// SharedData of its own future whichever way it is awaited.
+struct Pending
+{
+  Promise<int> promise;
+  int v;
+};
+
+std::vector<Pending> pending;
+
+Future<int> Step(int v)
+{
+  pending.push_back(Pending{Promise<int>(), v});
+  return pending.back().promise.GetFuture();
+}
+
+void Drain()
+{
+  while (!pending.empty()) {
+    Pending step = std::move(pending.back());
+    pending.pop_back();
+    step.promise.SetValue(step.v + 1);
+  }
+}
+
+Task<int> Steps()
+{
+  int v = 0;
+  for (int i = 0; i < kSteps; i++) {
+    Try<int> t = co_await Step(v);
+    if (t.HasError()) {
+      co_return std::move(t);
+    }
+    v = t.Value();
+  }
+
+  co_return v;
+}
+
+Future<int> ThenSteps()
+{
+  Future<int> f = Step(0);
+  for (int i = 1; i < kSteps; i++) {
+    f = f.Then([](int v) { return Step(v); });
+  }
+
+  return f;
+}
+
+template <class Run>
+void Measure(const char* label, Run run)
+{
+  pending.reserve(kSteps);
+
+  // Counted with exact allocations rather than pool hits.
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+  Stopwatch watch;
+
+  for (int round = 0; round < kRounds; round++) {
+    Future<int> f = run();
+    Drain();
+    DoNotOptimize(f.Value());
+  }
+
+  double nanos = watch.ElapsedNanos();
+  size_t allocations = counter.Count();
+  SetBlockAllocator(previous);
+
+  double steps = static_cast<double>(kRounds) * kSteps;
+  Report("AwaitSteps", std::string(label) + " allocations",
+         allocations / steps, "allocs/step");
+  Report("AwaitSteps", std::string(label) + " time", nanos / steps,
+         "ns/step");
+}
+
+}  // namespace
+
+// Each `Then` link adds a SharedData on top of the step's own; a `Task`
+// attaches straight to the step's future and pays one frame per sequence.
+DIEN_BENCHMARK(AwaitSteps)
+{
+  Measure("Then chain", []() { return ThenSteps(); });
+  Measure("Task co_await", []() { return Steps().Run(); });
+}
+
+#endif  // DIEN_HAS_COROUTINES
@@ -0,0 +1,39 @@
+/******************************************************************************
+ *
+ *  File:   dien_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Driver for `dien` benchmarks.
+ *
+ *  Usage: ./dien_benchmarks [--filter=<substring>]
+ *
+ ******************************************************************************/
+
+#include <cstring>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+
+int main(int argc, char** argv)
+{
+  google::InitGoogleLogging("dien-benchmarks");
+
+  std::string filter;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--filter=", 9) == 0) {
+      filter = argv[i] + 9;
+    }
+  }
+
+  for (const auto& benchmark : dien::bench::Registry()) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+
+    benchmark.body();
+  }
+
+  return 0;
+}
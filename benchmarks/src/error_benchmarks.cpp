@@ -0,0 +1,193 @@
+/******************************************************************************
+ *
+ *  File:   error_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Cost of creating, moving and stacking `Error`s, as in a
+ *              failure storm where every request fails, of errors that
+ *              are only checked by code and dropped, and of errors passed
+ *              down a 20-deep `Then` chain.
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocation_counter.hpp"
+#include "benchmark.hpp"
+#include "error.hpp"
+#include "future.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+using namespace dien::test;
+
+namespace
+{
+
+const int kErrors = 1000000;
+
+// Builds an error, hands it through two moves and adds one frame of
+// context, roughly what a failed request costs on its way to the caller.
+template <class Make>
+void Run(const std::string& label, Make make)
+{
+  AllocationCounter counter;
+  Stopwatch watch;
+
+  for (int i = 0; i < kErrors; i++) {
+    Error e = make(i);
+    Error moved(std::move(e));
+    moved.Stack(ErrorCode(kFailed));
+    Error last(std::move(moved));
+    DoNotOptimize(last.Top().Code());
+  }
+
+  double nanos = watch.ElapsedNanos();
+
+  Report("ErrorFailureStorm", label + " time", nanos / kErrors, "ns/error");
+  Report("ErrorFailureStorm", label + " allocations",
+         static_cast<double>(counter.Count()) / kErrors, "allocs/error");
+}
+
+// Builds an error and looks only at its code, comparing deferred formatting
+// with formatting on the spot.
+template <class Make>
+void RunDiscard(const std::string& label, Make make)
+{
+  AllocationCounter counter;
+  Stopwatch watch;
+
+  for (int i = 0; i < kErrors; i++) {
+    ErrorCode code = make(i);
+    DoNotOptimize(code.Code());
+  }
+
+  double nanos = watch.ElapsedNanos();
+
+  Report("ErrorConstructDiscard", label + " time", nanos / kErrors,
+         "ns/error");
+  Report("ErrorConstructDiscard", label + " allocations",
+         static_cast<double>(counter.Count()) / kErrors, "allocs/error");
+}
+
+const int kChainDepth = 20;
+const int kChains = 50000;
+
+void ReportChain(const std::string& label, double nanos, size_t allocations)
+{
+  Report("ErrorChain", label + " time", nanos / kChains, "ns/chain");
+  Report("ErrorChain", label + " allocations",
+         static_cast<double>(allocations) / kChains, "allocs/chain");
+}
+
+// A failure at the root of `kChainDepth` non-Try continuations, each of
+// which passes the error on untouched.
+void RunThenChain()
+{
+  std::vector<Future<int>> chain;
+  chain.reserve(kChainDepth);
+
+  size_t allocations = 0;
+  Stopwatch watch;
+
+  for (int i = 0; i < kChains; i++) {
+    AllocationCounter counter;
+
+    Promise<int> promise;
+    Future<int> f = promise.GetFuture();
+    for (int depth = 0; depth < kChainDepth; depth++) {
+      chain.push_back((chain.empty() ? f : chain.back()).Then([](int v) {
+        return v + 1;
+      }));
+    }
+
+    promise.SetError(Error(
+        ErrorCode(kFailed, kFormatLater, "shard %d unavailable", i)));
+    DoNotOptimize(chain.back().HasError());
+    chain.clear();
+
+    allocations += counter.Count();
+  }
+
+  ReportChain("Then propagation", watch.ElapsedNanos(), allocations);
+}
+
+// Every layer adds one frame of context and keeps a copy of what it passed
+// up, as a caller logging the error would.
+void RunContextChain()
+{
+  std::vector<Error> kept;
+  kept.reserve(kChainDepth);
+
+  size_t allocations = 0;
+  Stopwatch watch;
+
+  for (int i = 0; i < kChains; i++) {
+    AllocationCounter counter;
+
+    Error e(ErrorCode(kFailed, kFormatLater, "shard %d unavailable", i));
+    for (int depth = 0; depth < kChainDepth; depth++) {
+      e.Stack(ErrorCode(kFailed, kFormatLater, "layer %d", depth));
+      kept.push_back(e);
+    }
+
+    DoNotOptimize(kept.back().Top().Code());
+    kept.clear();
+
+    allocations += counter.Count();
+  }
+
+  ReportChain("context per layer", watch.ElapsedNanos(), allocations);
+}
+
+}  // namespace
+
+DIEN_BENCHMARK(ErrorChain)
+{
+  RunThenChain();
+  RunContextChain();
+}
+
+DIEN_BENCHMARK(ErrorConstructDiscard)
+{
+  RunDiscard("deferred short message", [](int i) {
+    return ErrorCode(kFailed, kFormatLater, "shard %d unavailable", i);
+  });
+
+  RunDiscard("formatted short message", [](int i) {
+    return ErrorCode(kFailed, "shard %d unavailable", i);
+  });
+
+  RunDiscard("deferred long message", [](int i) {
+    return ErrorCode(kFailed, kFormatLater,
+                     "shard %d of %d unavailable after %d retries: "
+                     "connection refused by the storage backend",
+                     i, 64, 3);
+  });
+
+  RunDiscard("formatted long message", [](int i) {
+    return ErrorCode(kFailed,
+                     "shard %d of %d unavailable after %d retries: "
+                     "connection refused by the storage backend",
+                     i, 64, 3);
+  });
+}
+
+DIEN_BENCHMARK(ErrorFailureStorm)
+{
+  Run("interned code", [](int) { return Error(ErrorCode(kTimedOut)); });
+
+  Run("formatted short message", [](int i) {
+    return Error(ErrorCode(kFailed, "shard %d unavailable", i));
+  });
+
+  Run("formatted long message", [](int i) {
+    return Error(ErrorCode(
+        kFailed, "shard %d unavailable: connection refused by backend %s", i,
+        "storage-primary"));
+  });
+}
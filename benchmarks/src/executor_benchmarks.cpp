@@ -0,0 +1,157 @@
+/******************************************************************************
+ *
+ *  File:   executor_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Throughput and tail latency of the shipped executors on
+ *              fan-out/fan-in graphs of tiny continuations.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "future.hpp"
+#include "thread_pool_executor.hpp"
+#include "work_stealing_executor.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+const size_t kContinuations = 1000000;
+const size_t kBatch = 10000;
+
+typedef std::chrono::steady_clock Clock;
+
+// Binary tree of tasks: every inner task adds two children from inside the
+// executor, every leaf counts down. Returns leaves per second.
+double SpawnTree(Executor& executor)
+{
+  std::atomic<size_t> remaining(kContinuations);
+
+  struct Spawner
+  {
+    static void Spawn(Executor& executor, std::atomic<size_t>& remaining,
+                      size_t leaves)
+    {
+      if (leaves == 1) {
+        remaining--;
+        return;
+      }
+
+      size_t half = leaves / 2;
+      executor.Add([&executor, &remaining, half]() {
+        Spawn(executor, remaining, half);
+      });
+      executor.Add([&executor, &remaining, leaves, half]() {
+        Spawn(executor, remaining, leaves - half);
+      });
+    }
+  };
+
+  Stopwatch watch;
+
+  executor.Add([&]() { Spawner::Spawn(executor, remaining, kContinuations); });
+  while (remaining.load() != 0) {
+    std::this_thread::yield();
+  }
+
+  return kContinuations / watch.ElapsedSeconds();
+}
+
+// A task on the executor fulfils a batch of promises whose continuations are
+// scheduled on the same executor (fan-out); the continuations count down to
+// a join (fan-in). Latency is fulfilment to continuation start.
+void FanOutFanIn(Executor& executor, const std::string& name)
+{
+  std::vector<double> latencies(kContinuations);
+  std::vector<Clock::time_point> fulfilled(kBatch);
+
+  Stopwatch watch;
+
+  for (size_t base = 0; base < kContinuations; base += kBatch) {
+    std::vector<Promise<size_t>> promises(kBatch);
+    std::vector<Future<void>> continuations;
+    continuations.reserve(kBatch);
+    std::atomic<size_t> pending(kBatch);
+
+    for (size_t i = 0; i < kBatch; i++) {
+      continuations.push_back(promises[i].GetFuture().Then(
+          &executor, [&, base](size_t index) {
+            latencies[base + index] = std::chrono::duration<double, std::nano>(
+                                          Clock::now() - fulfilled[index])
+                                          .count();
+            pending--;
+          }));
+    }
+
+    executor.Add([&]() {
+      for (size_t i = 0; i < kBatch; i++) {
+        fulfilled[i] = Clock::now();
+        promises[i].SetValue(i);
+      }
+    });
+
+    while (pending.load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  double seconds = watch.ElapsedSeconds();
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+
+  Report("ExecutorFanOutFanIn", name + " throughput", kContinuations / seconds,
+         "continuations/s");
+  Report("ExecutorFanOutFanIn", name + " latency p50", percentile(0.50), "ns");
+  Report("ExecutorFanOutFanIn", name + " latency p99", percentile(0.99), "ns");
+  Report("ExecutorFanOutFanIn", name + " latency p99.9", percentile(0.999),
+         "ns");
+}
+
+}  // namespace
+
+DIEN_BENCHMARK(ExecutorSpawnTree)
+{
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  {
+    ThreadPoolExecutor executor(cores);
+    Report("ExecutorSpawnTree", "thread pool (shared queue)",
+           SpawnTree(executor), "tasks/s");
+  }
+
+  {
+    WorkStealingExecutor executor(cores);
+    Report("ExecutorSpawnTree", "work stealing", SpawnTree(executor),
+           "tasks/s");
+  }
+}
+
+DIEN_BENCHMARK(ExecutorFanOutFanIn)
+{
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  {
+    ThreadPoolExecutor executor(cores);
+    FanOutFanIn(executor, "thread pool (shared queue)");
+  }
+
+  {
+    WorkStealingExecutor executor(cores);
+    FanOutFanIn(executor, "work stealing");
+  }
+}
@@ -0,0 +1,112 @@
+/******************************************************************************
+ *
+ *  File:   fulfil_batch_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Fulfilling the promises answered by one response with
+ *              `FulfilBatch` against a `SetValue` per promise, with the
+ *              continuations inline and on an executor.
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "future.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+const int kPending = 256;
+const int kRounds = 4000;
+
+// Queues tasks until `Drain`; counts submissions.
+class QueueExecutor : public Executor
+{
+ public:
+  void Add(Func func) override
+  {
+    submits++;
+    queue_.push_back(std::move(func));
+  }
+
+  void Drain()
+  {
+    for (size_t i = 0; i < queue_.size(); i++) {
+      queue_[i]();
+    }
+    queue_.clear();
+  }
+
+  size_t submits = 0;
+
+ private:
+  std::vector<Func> queue_;
+};  // class QueueExecutor
+
+void Measure(const char* label, bool batch, QueueExecutor* executor)
+{
+  long sum = 0;
+  double nanos = 0;
+  if (executor) {
+    executor->submits = 0;
+  }
+
+  std::vector<Promise<int>> promises;
+  std::vector<int> values;
+  for (int round = 0; round < kRounds; round++) {
+    promises.clear();
+    promises.resize(kPending);
+    for (auto& promise : promises) {
+      Future<int> f = promise.GetFuture();
+      if (executor && !batch) {
+        f.Via(executor);
+      }
+      f.Then([&sum](int v) { sum += v; });
+    }
+
+    values.assign(kPending, round);
+
+    Stopwatch watch;
+    if (batch) {
+      FulfilBatch<int>(promises, values, executor);
+    } else {
+      for (int i = 0; i < kPending; i++) {
+        promises[i].SetValue(values[i]);
+      }
+    }
+    if (executor) {
+      executor->Drain();
+    }
+    nanos += watch.ElapsedNanos();
+  }
+
+  DoNotOptimize(sum);
+
+  double total = static_cast<double>(kRounds) * kPending;
+  Report("FulfilBatch", std::string(label) + " time", nanos / total,
+         "ns/promise");
+  if (executor) {
+    Report("FulfilBatch", std::string(label) + " submits",
+           executor->submits / static_cast<double>(kRounds), "submits/batch");
+  }
+}
+
+}  // namespace
+
+// One response answering `kPending` requests, each with a continuation.
+DIEN_BENCHMARK(FulfilBatch)
+{
+  QueueExecutor executor;
+
+  Measure("SetValue each", false, nullptr);
+  Measure("FulfilBatch", true, nullptr);
+  Measure("SetValue each Via", false, &executor);
+  Measure("FulfilBatch executor", true, &executor);
+}
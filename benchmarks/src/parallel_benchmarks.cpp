@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ *  File:   parallel_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Scaling of `ParallelFor` and `ParallelReduce` from one
+ *              thread to every hardware thread, on a memory-bound and a
+ *              compute-bound kernel.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "parallel.hpp"
+#include "work_stealing_executor.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+// Three arrays of 4M doubles: well past the last-level cache.
+const size_t kTriadSize = 4 << 20;
+const size_t kTriadGrain = 4096;
+
+// Few indices, many dependent multiplies each.
+const size_t kComputeSize = 1 << 16;
+const size_t kComputeGrain = 64;
+const int kIterations = 400;
+
+const int kRepeats = 5;
+
+std::vector<size_t> ThreadCounts()
+{
+  size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<size_t> counts;
+  for (size_t threads = 1; threads < hardware; threads *= 2) {
+    counts.push_back(threads);
+  }
+  counts.push_back(hardware);
+  return counts;
+}
+
+// a[i] = b[i] + s * c[i]
+double Triad(WorkStealingExecutor& executor, std::vector<double>& a,
+             const std::vector<double>& b, const std::vector<double>& c)
+{
+  Stopwatch watch;
+
+  for (int repeat = 0; repeat < kRepeats; repeat++) {
+    Future<void> f = ParallelFor(executor, 0, kTriadSize, kTriadGrain,
+                                 [&a, &b, &c](size_t i) {
+                                   a[i] = b[i] + 3.0 * c[i];
+                                 });
+    f.Wait();
+  }
+
+  return watch.ElapsedNanos() / kRepeats;
+}
+
+double Iterate(size_t i)
+{
+  double x = 0.0;
+  double c = 0.25 + static_cast<double>(i % 1024) / 8192.0;
+  for (int k = 0; k < kIterations; k++) {
+    x = x * x * 0.5 + c;
+  }
+  return x;
+}
+
+double Compute(WorkStealingExecutor& executor)
+{
+  Stopwatch watch;
+
+  for (int repeat = 0; repeat < kRepeats; repeat++) {
+    Future<double> f = ParallelReduce(
+        executor, 0, kComputeSize, kComputeGrain, 0.0,
+        [](double&& sum, size_t i) { return sum + Iterate(i); },
+        [](double&& a, double&& b) { return a + b; });
+    f.Wait();
+    DoNotOptimize(f.Value());
+  }
+
+  return watch.ElapsedNanos() / kRepeats;
+}
+
+}  // namespace
+
+// Speedup is against the same kernel on a one-thread executor. The triad
+// stops scaling once memory bandwidth runs out; the compute kernel should
+// scale with the number of cores.
+DIEN_BENCHMARK(ParallelScaling)
+{
+  std::vector<double> a(kTriadSize, 0.0);
+  std::vector<double> b(kTriadSize, 1.0);
+  std::vector<double> c(kTriadSize, 2.0);
+
+  double triad_base = 0;
+  double compute_base = 0;
+
+  for (size_t threads : ThreadCounts()) {
+    WorkStealingExecutor executor(threads);
+
+    double triad = Triad(executor, a, b, c);
+    double compute = Compute(executor);
+    if (threads == 1) {
+      triad_base = triad;
+      compute_base = compute;
+    }
+
+    std::string label = std::to_string(threads) + " threads";
+    Report("ParallelScaling", "Triad " + label + " time", triad / 1e6, "ms");
+    Report("ParallelScaling", "Triad " + label + " speedup",
+           triad_base / triad, "x");
+    Report("ParallelScaling", "Compute " + label + " time", compute / 1e6,
+           "ms");
+    Report("ParallelScaling", "Compute " + label + " speedup",
+           compute_base / compute, "x");
+  }
+
+  DoNotOptimize(a[kTriadSize / 2]);
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ *  File:   scoped_lock_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `SpinLock` waiting policies under core oversubscription.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "scoped_lock.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+// `threads` threads each take the lock `iterations` times around a short
+// critical section. Returns lock acquisitions per second.
+template <class Policy>
+double Throughput(unsigned threads, unsigned iterations)
+{
+  SpinLock<Policy> lock;
+  unsigned long shared = 0;
+
+  Stopwatch watch;
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back([&]() {
+      for (unsigned j = 0; j < iterations; j++) {
+        ScopedLock<Policy> guard(lock);
+        for (int k = 0; k < 16; k++) {
+          shared = shared * 31 + k;
+        }
+      }
+    });
+  }
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  DoNotOptimize(shared);
+  return threads * static_cast<double>(iterations) / watch.ElapsedSeconds();
+}
+
+}  // namespace
+
+DIEN_BENCHMARK(SpinLockOversubscription)
+{
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned iterations = 20000;
+
+  for (unsigned factor : {2u, 8u}) {
+    unsigned threads = cores * factor;
+    std::string label = std::to_string(factor) + "x cores (" +
+                        std::to_string(threads) + " threads) ";
+
+    Report("SpinLockOversubscription", label + "spin",
+           Throughput<SpinPolicy>(threads, iterations), "locks/s");
+    Report("SpinLockOversubscription", label + "pause+yield",
+           Throughput<YieldPolicy>(threads, iterations), "locks/s");
+    Report("SpinLockOversubscription", label + "pause+yield+park",
+           Throughput<ParkPolicy>(threads, iterations), "locks/s");
+  }
+}
@@ -0,0 +1,331 @@
+/******************************************************************************
+ *
+ *  File:   shared_data_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Contention, ping-pong and footprint benchmarks for
+ *              `SharedData`.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "future.hpp"
+#include "perf_counter.hpp"
+
+namespace
+{
+
+// An int whose futures use the split `SharedData` layout.
+struct SplitInt
+{
+  int v;
+};
+
+}  // namespace
+
+namespace dien
+{
+
+template <>
+struct SplitSharedDataLayout<SplitInt> : std::true_type
+{};
+
+}  // namespace dien
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+// The pre lock-free `SharedData` protocol: every transition and every
+// readiness check takes an `atomic_flag` spinlock. Kept here as the baseline.
+class SpinLockedState
+{
+ public:
+  bool Ready() const
+  {
+    while (lock_.test_and_set(std::memory_order_acquire)) {}
+    bool ready = state_ != kStart && state_ != kOnlyCallback;
+    lock_.clear(std::memory_order_release);
+    return ready;
+  }
+
+  void SetResult(Try<int>&& result)
+  {
+    while (lock_.test_and_set(std::memory_order_acquire)) {}
+    result_ = std::move(result);
+    state_ = kOnlyResult;
+    lock_.clear(std::memory_order_release);
+  }
+
+ private:
+  mutable std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+  Option<Try<int>> result_;
+  State state_ = kStart;
+};
+
+// One producer publishes `count` results in order while `pollers` threads
+// spin on `Ready()` of the slot the producer is about to publish. Returns the
+// producer's cost per publish in nanoseconds.
+template <class S>
+double PollContention(size_t count, unsigned pollers)
+{
+  std::unique_ptr<S[]> states(new S[count]);
+  std::atomic<unsigned> started(0);
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < pollers; i++) {
+    threads.emplace_back([&]() {
+      started++;
+      for (size_t slot = 0; slot < count; slot++) {
+        while (!states[slot].Ready()) {}
+      }
+    });
+  }
+
+  while (started.load() != pollers) {}
+
+  Stopwatch watch;
+  for (size_t slot = 0; slot < count; slot++) {
+    states[slot].SetResult(Try<int>(static_cast<int>(slot)));
+  }
+  double elapsed = watch.ElapsedNanos();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  return elapsed / count;
+}
+
+// Contiguous, suitably aligned `SharedData<T, true>`s.
+template <class T>
+class StateArray
+{
+ public:
+  typedef SharedData<T, true> State;
+
+  explicit StateArray(size_t count)
+      : count_(count), raw_(::operator new(count * sizeof(State) +
+                                           alignof(State)))
+  {
+    uintptr_t p = reinterpret_cast<uintptr_t>(raw_) + alignof(State) - 1;
+    states_ = reinterpret_cast<State*>(p & ~(alignof(State) - 1));
+    for (size_t i = 0; i < count_; i++) {
+      ::new (states_ + i) State();
+    }
+  }
+
+  ~StateArray()
+  {
+    for (size_t i = 0; i < count_; i++) {
+      states_[i].~State();
+    }
+    ::operator delete(raw_);
+  }
+
+  State& operator[](size_t i)
+  {
+    return states_[i];
+  }
+
+ private:
+  size_t count_;
+  void* raw_;
+  State* states_;
+};
+
+// Two threads take turns: each round the requester fulfils `ping[i]` and
+// waits on `pong[i]`, which the responder fulfils once it sees `ping[i]`.
+// Each side also attaches a callback to the state the other side is
+// fulfilling, so producer and consumer writes land on the same states at the
+// same time. Returns nanoseconds per round trip; `misses` receives the
+// requester's cache misses per round trip, if counters are available.
+template <class T>
+double PingPong(size_t rounds, double* misses)
+{
+  StateArray<T> ping(rounds);
+  StateArray<T> pong(rounds);
+  std::atomic<size_t> callbacks(0);
+
+  auto count = [&callbacks](Try<T>&&) {
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  std::thread responder([&]() {
+    for (size_t i = 0; i < rounds; i++) {
+      ping[i].SetCallback(count);
+      ping[i].WaitUntil(Deadline::max());
+      pong[i].SetResult(Try<T>(T{static_cast<int>(i)}));
+    }
+  });
+
+  PerfCounter counter;
+  counter.Start();
+  Stopwatch watch;
+
+  for (size_t i = 0; i < rounds; i++) {
+    pong[i].SetCallback(count);
+    ping[i].SetResult(Try<T>(T{static_cast<int>(i)}));
+    pong[i].WaitUntil(Deadline::max());
+  }
+
+  double nanos = watch.ElapsedNanos();
+  *misses = static_cast<double>(counter.Stop()) / rounds;
+
+  responder.join();
+  CHECK_EQ(callbacks.load(), 2 * rounds);
+
+  return nanos / rounds;
+}
+
+// Forwards to the heap and tallies what was asked for.
+class TallyingAllocator : public BlockAllocator
+{
+ public:
+  void* Allocate(size_t size) override
+  {
+    blocks++;
+    bytes += size;
+    return ::operator new(size);
+  }
+
+  void Deallocate(void* block, size_t) override
+  {
+    ::operator delete(block);
+  }
+
+  size_t blocks = 0;
+  size_t bytes = 0;
+};
+
+}  // namespace
+
+DIEN_BENCHMARK(SharedDataPollContention)
+{
+  const size_t count = 200000;
+  unsigned max_pollers =
+      std::max(1u, std::thread::hardware_concurrency() - 1);
+
+  for (unsigned pollers = 1; pollers <= max_pollers; pollers *= 2) {
+    std::string label = "1 producer / " + std::to_string(pollers) + " pollers";
+
+    Report("SharedDataPollContention", label + " spinlock",
+           PollContention<SpinLockedState>(count, pollers), "ns/publish");
+    Report("SharedDataPollContention", label + " lock-free",
+           PollContention<SharedData<int, true>>(count, pollers),
+           "ns/publish");
+  }
+}
+
+DIEN_BENCHMARK(SharedDataPingPong)
+{
+  const size_t rounds = 200000;
+  double misses = 0;
+
+  bool counted = PerfCounter().Valid();
+  if (!counted) {
+    Report("SharedDataPingPong", "cache misses unavailable (no PMU access)",
+           0, "");
+  }
+
+  Report("SharedDataPingPong", "compact layout",
+         PingPong<int>(rounds, &misses), "ns/round trip");
+  if (counted) {
+    Report("SharedDataPingPong", "compact layout cache misses", misses,
+           "misses/round trip");
+  }
+
+  Report("SharedDataPingPong", "split layout",
+         PingPong<SplitInt>(rounds, &misses), "ns/round trip");
+  if (counted) {
+    Report("SharedDataPingPong", "split layout cache misses", misses,
+           "misses/round trip");
+  }
+}
+
+// Memory held per outstanding `Future<int>`: the handle itself plus the
+// shared state it points to, pending and with a continuation attached.
+DIEN_BENCHMARK(FutureFootprint)
+{
+  const size_t count = 100000;
+
+  Report("FutureFootprint", "sizeof(Future<int>)", sizeof(Future<int>),
+         "bytes");
+  Report("FutureFootprint", "sizeof(Promise<int>)", sizeof(Promise<int>),
+         "bytes");
+  Report("FutureFootprint", "sizeof(SharedData<int>)",
+         sizeof(SharedData<int>), "bytes");
+
+  TallyingAllocator tally;
+  SetBlockAllocator(&tally);
+
+  {
+    std::vector<Promise<int>> promises(count);
+    std::vector<Future<int>> futures;
+    futures.reserve(count);
+    for (auto& promise : promises) {
+      futures.push_back(promise.GetFuture());
+    }
+
+    // Block sizes include the allocator's per-block header.
+    Report("FutureFootprint", "pending Future<int> shared state",
+           static_cast<double>(tally.bytes) / count, "bytes/future");
+
+    size_t bytes = tally.bytes;
+    size_t blocks = tally.blocks;
+    std::vector<Future<int>> links;
+    links.reserve(count);
+    for (auto& future : futures) {
+      int* sink = nullptr;
+      links.push_back(future.Then([sink](int v) { return v + 1; }));
+    }
+
+    Report("FutureFootprint", "Then link shared state",
+           static_cast<double>(tally.bytes - bytes) / count, "bytes/link");
+    Report("FutureFootprint", "Then link blocks",
+           static_cast<double>(tally.blocks - blocks) / count, "blocks/link");
+  }
+
+  SetBlockAllocator(nullptr);
+}
+
+// One future's whole life on one thread: promise and future created, a
+// continuation attached, the value set, both sides detached. Every atomic
+// read-modify-write on the state word is in here.
+DIEN_BENCHMARK(FutureLifecycle)
+{
+  const int rounds = 1000000;
+
+  for (bool callback_first : {true, false}) {
+    long sum = 0;
+    Stopwatch watch;
+
+    for (int round = 0; round < rounds; round++) {
+      Promise<int> promise;
+      Future<int> f = promise.GetFuture();
+      if (!callback_first) {
+        promise.SetValue(round);
+      }
+      f.SetCallback_([&sum](Try<int>&& t) { sum += t.Value(); });
+      if (callback_first) {
+        promise.SetValue(round);
+      }
+    }
+
+    DoNotOptimize(sum);
+    Report("FutureLifecycle",
+           callback_first ? "callback first" : "result first",
+           watch.ElapsedNanos() / rounds, "ns/future");
+  }
+}
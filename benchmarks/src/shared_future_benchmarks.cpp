@@ -0,0 +1,112 @@
+/******************************************************************************
+ *
+ *  File:   shared_future_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: One result fanned out to many consumers through a
+ *              `SharedFuture` against a promise per consumer, each fulfilled
+ *              with its own copy of the result.
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocation_counter.hpp"
+#include "benchmark.hpp"
+#include "shared_future.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+using namespace dien::test;
+
+namespace
+{
+
+// Stands in for an expensive backend result.
+typedef std::vector<int> Result;
+
+const size_t kResultSize = 256;
+const int kConsumersPerRound = 200000;
+
+long Consume(const Result& r)
+{
+  return r[0] + static_cast<long>(r.size());
+}
+
+// The workaround: one promise per waiter, fulfilled with a copy.
+void PromisePerConsumer(int consumers, long& sum)
+{
+  Promise<Result> source;
+  std::vector<Promise<Result>> waiters(consumers);
+
+  for (auto& waiter : waiters) {
+    waiter.GetFuture().Then([&sum](Result r) { sum += Consume(r); });
+  }
+
+  source.GetFuture().Then([&waiters](Result r) {
+    for (auto& waiter : waiters) {
+      waiter.SetValue(r);
+    }
+  });
+
+  source.SetValue(Result(kResultSize, 1));
+}
+
+void Shared(int consumers, long& sum)
+{
+  Promise<Result> source;
+  SharedFuture<Result> shared(source.GetFuture());
+
+  for (int i = 0; i < consumers; i++) {
+    shared.SetCallback(
+        [&sum](const Try<Result>& t) { sum += Consume(t.Value()); });
+  }
+
+  source.SetValue(Result(kResultSize, 1));
+}
+
+void Measure(const char* label, int consumers, void (*run)(int, long&))
+{
+  int rounds = kConsumersPerRound / consumers;
+  if (rounds == 0) {
+    rounds = 1;
+  }
+
+  long sum = 0;
+
+  // Counted with exact allocations rather than pool hits.
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+  Stopwatch watch;
+
+  for (int round = 0; round < rounds; round++) {
+    run(consumers, sum);
+  }
+
+  double nanos = watch.ElapsedNanos();
+  size_t allocations = counter.Count();
+  SetBlockAllocator(previous);
+
+  DoNotOptimize(sum);
+
+  double total = static_cast<double>(rounds) * consumers;
+  std::string name = std::string(label) + " x" + std::to_string(consumers);
+  Report("SharedFanOut", name + " allocations", allocations / total,
+         "allocs/consumer");
+  Report("SharedFanOut", name + " time", nanos / total, "ns/consumer");
+}
+
+}  // namespace
+
+// Per consumer, the copies cost a SharedData, a vector and the copy itself;
+// a `SharedFuture` costs one list node past the first consumer.
+DIEN_BENCHMARK(SharedFanOut)
+{
+  for (int consumers : {1, 16, 10000}) {
+    Measure("Promise per consumer", consumers, PromisePerConsumer);
+    Measure("SharedFuture", consumers, Shared);
+  }
+}
@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ *  File:   stream_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Passing a run of values to a consumer through a `Stream`
+ *              against one Promise/Future pair per value.
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocation_counter.hpp"
+#include "benchmark.hpp"
+#include "stream.hpp"
+#include "thread_pool_executor.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+using namespace dien::test;
+
+namespace
+{
+
+const int kElements = 1000000;
+const int kBatch = 64;
+
+void Measure(const char* label, void (*run)(long&))
+{
+  long sum = 0;
+
+  // Counted with exact allocations rather than pool hits.
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+  Stopwatch watch;
+
+  run(sum);
+
+  double nanos = watch.ElapsedNanos();
+  size_t allocations = counter.Count();
+  SetBlockAllocator(previous);
+
+  DoNotOptimize(sum);
+  Report("StreamDelivery", std::string(label) + " allocations",
+         static_cast<double>(allocations) / kElements, "allocs/element");
+  Report("StreamDelivery", std::string(label) + " time",
+         nanos / kElements, "ns/element");
+}
+
+void FuturePerElement(long& sum)
+{
+  for (int i = 0; i < kElements; i++) {
+    Promise<int> promise;
+    promise.GetFuture().Then([&sum](int v) { sum += v; });
+    promise.SetValue(i);
+  }
+}
+
+void StreamPerElement(long& sum)
+{
+  StreamWriter<int> writer;
+  Future<void> done = writer.GetStream().ForEach([&sum](int v) { sum += v; });
+
+  for (int i = 0; i < kElements; i++) {
+    writer.Write(i);
+  }
+  writer.Close();
+}
+
+void StreamBatches(long& sum)
+{
+  StreamWriter<int> writer;
+  Future<void> done = writer.GetStream().ForEach([&sum](int v) { sum += v; });
+
+  std::vector<int> batch;
+  for (int i = 0; i < kElements; i += kBatch) {
+    batch.clear();
+    for (int j = i; j < i + kBatch && j < kElements; j++) {
+      batch.push_back(j);
+    }
+    writer.Write(batch);
+  }
+  writer.Close();
+}
+
+// The consumer on its own thread. A delivery scheduled while the consumer
+// is busy takes everything written in between.
+int deliveries = 0;
+
+void StreamAcrossThreads(long& sum)
+{
+  SingleThreadExecutor executor;
+  StreamWriter<int> writer;
+
+  deliveries = 0;
+  Future<void> done = writer.GetStream().Via(&executor).ForEachBatch(
+      [&sum](std::vector<int>& batch) {
+        deliveries++;
+        for (int v : batch) {
+          sum += v;
+        }
+      });
+
+  for (int i = 0; i < kElements; i++) {
+    Future<void> room = writer.Write(i);
+    if (!room.IsReady()) {
+      room.Wait();
+    }
+  }
+  writer.Close();
+  done.Wait();
+}
+
+}  // namespace
+
+// Every pair costs a SharedData and a callback dispatch; the stream shares
+// one state and one sink call per delivery, so its cost per element falls
+// as deliveries grow.
+DIEN_BENCHMARK(StreamDelivery)
+{
+  Measure("Future per element", FuturePerElement);
+  Measure("Stream Write", StreamPerElement);
+  Measure("Stream Write 64", StreamBatches);
+  Measure("Stream Via", StreamAcrossThreads);
+  Report("StreamDelivery", "Stream Via deliveries",
+         static_cast<double>(kElements) / deliveries, "elements/delivery");
+}
@@ -0,0 +1,192 @@
+/******************************************************************************
+ *
+ *  File:   then_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Cost per `Then` link: heap allocations and time, and how
+ *              chains whose intermediate futures are dropped compare with
+ *              chains that keep them, and chains on futures born ready.
+ *
+ ******************************************************************************/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "allocation_counter.hpp"
+#include "benchmark.hpp"
+#include "future.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+using namespace dien::test;
+
+namespace
+{
+
+const int kDepth = 16;
+const int kRounds = 20000;
+
+// A link built the way `Then` used to: the continuation holds the downstream
+// Promise through a shared_ptr, costing a control block per link.
+Future<int> SharedPromiseLink(Future<int>& f)
+{
+  std::shared_ptr<Promise<int>> p = std::make_shared<Promise<int>>();
+  Future<int> next = p->GetFuture();
+
+  f.SetCallback_([p](Try<int>&& t) { p->SetValue(t.Value() + 1); });
+
+  return next;
+}
+
+Future<int> ThenLink(Future<int>& f)
+{
+  return f.Then([](int v) { return v + 1; });
+}
+
+template <class Link>
+void Run(const char* label, Link link)
+{
+  std::vector<Future<int>> chain;
+  chain.reserve(kDepth);
+
+  size_t allocations = 0;
+  Stopwatch watch;
+
+  for (int round = 0; round < kRounds; round++) {
+    AllocationCounter counter;
+
+    Promise<int> promise;
+    Future<int> f = promise.GetFuture();
+
+    for (int i = 0; i < kDepth; i++) {
+      chain.push_back(link(chain.empty() ? f : chain.back()));
+    }
+
+    promise.SetValue(0);
+    DoNotOptimize(chain.back().Value());
+    chain.clear();
+
+    allocations += counter.Count();
+  }
+
+  double links = static_cast<double>(kRounds) * kDepth;
+  Report("ThenLinkCost", std::string(label) + " allocations",
+         allocations / links, "allocs/link");
+  Report("ThenLinkCost", std::string(label) + " time",
+         watch.ElapsedNanos() / links, "ns/link");
+}
+
+const int kLinksPerDepth = 400000;
+
+// Builds `depth` links on an unfulfilled source and then fulfils it, either
+// dropping each intermediate future into the next `Then` (so its state runs
+// its link in line) or keeping every one of them alive.
+void RunChain(int depth, bool keep)
+{
+  int rounds = kLinksPerDepth / depth;
+  std::vector<Future<int>> kept;
+  kept.reserve(depth);
+
+  double build_nanos = 0;
+  double fire_nanos = 0;
+
+  for (int round = 0; round < rounds; round++) {
+    Promise<int> promise;
+    Future<int> f = promise.GetFuture();
+
+    Stopwatch watch;
+    for (int i = 0; i < depth; i++) {
+      Future<int> next = f.Then([](int v) { return v + 1; });
+      if (keep) {
+        kept.push_back(std::move(f));
+      }
+      f = std::move(next);
+    }
+    build_nanos += watch.ElapsedNanos();
+
+    watch.Reset();
+    promise.SetValue(0);
+    DoNotOptimize(f.Value());
+    fire_nanos += watch.ElapsedNanos();
+
+    kept.clear();
+  }
+
+  std::string label = (keep ? "kept depth " : "dropped depth ") +
+                      std::to_string(depth);
+  double links = static_cast<double>(rounds) * depth;
+  Report("ThenChain", label + " build", build_nanos / links, "ns/link");
+  Report("ThenChain", label + " fulfil", fire_nanos / links, "ns/link");
+}
+
+// `Then` links on a future that is already fulfilled: either one built from
+// a value, which holds it inline, or one whose Promise was fulfilled first,
+// which has a SharedData to go through.
+void RunReady(const char* label, bool inline_value)
+{
+  const int rounds = kLinksPerDepth / kDepth;
+
+  // Counted with exact allocations rather than pool hits.
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+  Stopwatch watch;
+
+  for (int round = 0; round < rounds; round++) {
+    Future<int> f(0);
+    if (!inline_value) {
+      Promise<int> promise;
+      promise.SetValue(0);
+      f = promise.GetFuture();
+    }
+
+    for (int i = 0; i < kDepth; i++) {
+      f = f.Then([](int v) { return v + 1; });
+    }
+
+    DoNotOptimize(f.Value());
+  }
+
+  double nanos = watch.ElapsedNanos();
+  size_t allocations = counter.Count();
+  SetBlockAllocator(previous);
+
+  double links = static_cast<double>(rounds) * kDepth;
+  Report("ThenOnReady", std::string(label) + " allocations",
+         allocations / links, "allocs/link");
+  Report("ThenOnReady", std::string(label) + " time", nanos / links,
+         "ns/link");
+}
+
+}  // namespace
+
+// Allocations per link, counted over build + fulfil + destroy of a chain
+// (the source Promise's SharedData is amortized over the chain):
+//
+//   std::function + shared_ptr<Promise> (original Then):  3 per link
+//   InlineFunction + shared_ptr<Promise> (measured):      2 per link
+//   InlineFunction + moved-in Promise (measured, Then):   1 per link
+DIEN_BENCHMARK(ThenLinkCost)
+{
+  Run("shared_ptr<Promise> link", &SharedPromiseLink);
+  Run("Then (Promise moved into callback)", &ThenLink);
+}
+
+// A dropped intermediate state has only its Promise left and its callback
+// attached, so fulfilling it runs the next link directly instead of going
+// through the publish / arm / dispatch handshake. Kept states cannot.
+DIEN_BENCHMARK(ThenChain)
+{
+  for (int depth = 1; depth <= 32; depth *= 2) {
+    RunChain(depth, false);
+    RunChain(depth, true);
+  }
+}
+
+DIEN_BENCHMARK(ThenOnReady)
+{
+  RunReady("fulfilled Promise", false);
+  RunReady("inline value", true);
+}
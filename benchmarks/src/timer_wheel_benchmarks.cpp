@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ *  File:   timer_wheel_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Cost of arming, cancelling and firing 100k concurrent
+ *              deadlines through `Future::Within`.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "future.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+const size_t kDeadlines = 100000;
+
+typedef std::chrono::steady_clock Clock;
+
+}  // namespace
+
+// Every RPC answers before its deadline: the timers are armed, then
+// cancelled by the arriving results.
+DIEN_BENCHMARK(TimerWheelCancel)
+{
+  std::vector<Promise<int>> promises(kDeadlines);
+  std::vector<Future<int>> futures;
+  futures.reserve(kDeadlines);
+
+  Stopwatch arm;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture().Within(std::chrono::seconds(30)));
+  }
+  Report("TimerWheelCancel", "arm Within", arm.ElapsedNanos() / kDeadlines,
+         "ns/deadline");
+
+  Stopwatch fulfil;
+  for (auto& promise : promises) {
+    promise.SetValue(1);
+  }
+  Report("TimerWheelCancel", "fulfil and cancel",
+         fulfil.ElapsedNanos() / kDeadlines, "ns/deadline");
+}
+
+// No RPC answers: every deadline, spread over one second, fires. Lateness is
+// the time from the deadline to the timeout continuation running.
+DIEN_BENCHMARK(TimerWheelExpire)
+{
+  std::vector<Promise<int>> promises(kDeadlines);
+  std::vector<Future<void>> futures;
+  futures.reserve(kDeadlines);
+  std::vector<double> lateness(kDeadlines);
+  std::atomic<size_t> remaining(kDeadlines);
+
+  for (size_t i = 0; i < kDeadlines; i++) {
+    auto delay = std::chrono::microseconds((i * 7919) % 1000000);
+    Clock::time_point deadline = Clock::now() + delay;
+
+    futures.push_back(promises[i].GetFuture().Within(delay).Then(
+        [&lateness, &remaining, deadline, i](Try<int>&) {
+          lateness[i] = std::chrono::duration<double, std::micro>(
+                            Clock::now() - deadline)
+                            .count();
+          remaining--;
+        }));
+  }
+
+  while (remaining.load() != 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::sort(lateness.begin(), lateness.end());
+
+  Report("TimerWheelExpire", "lateness p50", lateness[kDeadlines / 2], "us");
+  Report("TimerWheelExpire", "lateness p99", lateness[kDeadlines * 99 / 100],
+         "us");
+  Report("TimerWheelExpire", "lateness max", lateness.back(), "us");
+}
@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ *  File:   try_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Footprint of `Try` results: size and the cost, in time and
+ *              cache misses, of scanning a large vector of them.
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "perf_counter.hpp"
+#include "try.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+// Large enough that the vector lives well outside the caches.
+const size_t kResults = 1 << 22;
+const int kScans = 10;
+
+// One result in `kErrorEvery` is an error.
+const size_t kErrorEvery = 64;
+
+int64_t Sum(const std::vector<Try<int>>& results)
+{
+  int64_t sum = 0;
+  for (const Try<int>& t : results) {
+    if (t.HasValue()) {
+      sum += t.Value();
+    }
+  }
+
+  return sum;
+}
+
+int64_t Sum(const std::vector<Try<void>>& results)
+{
+  int64_t failed = 0;
+  for (const Try<void>& t : results) {
+    failed += t.HasError();
+  }
+
+  return failed;
+}
+
+int64_t Sum(const std::vector<int>& results)
+{
+  int64_t sum = 0;
+  for (int v : results) {
+    sum += v;
+  }
+
+  return sum;
+}
+
+template <class Vector>
+void Scan(const std::string& label, const Vector& results)
+{
+  PerfCounter misses;
+  uint64_t miss_count = 0;
+  Stopwatch watch;
+
+  for (int scan = 0; scan < kScans; scan++) {
+    misses.Start();
+    DoNotOptimize(Sum(results));
+    miss_count += misses.Stop();
+  }
+
+  double scanned = static_cast<double>(kResults) * kScans;
+
+  Report("TryScan", label + " size", sizeof(results[0]), "bytes");
+  Report("TryScan", label + " time", watch.ElapsedNanos() / scanned,
+         "ns/result");
+  if (misses.Valid()) {
+    Report("TryScan", label + " cache misses", miss_count / scanned,
+           "misses/result");
+  }
+}
+
+}  // namespace
+
+DIEN_BENCHMARK(TryScan)
+{
+  if (!PerfCounter().Valid()) {
+    Report("TryScan", "cache misses unavailable (no PMU access)", 0, "");
+  }
+
+  {
+    std::vector<int> results(kResults);
+    for (size_t i = 0; i < kResults; i++) {
+      results[i] = static_cast<int>(i);
+    }
+    Scan("int (baseline)", results);
+  }
+
+  {
+    std::vector<Try<int>> results;
+    results.reserve(kResults);
+    for (size_t i = 0; i < kResults; i++) {
+      if (i % kErrorEvery == 0) {
+        results.emplace_back(Error(ErrorCode(kFailed)));
+      } else {
+        results.emplace_back(static_cast<int>(i));
+      }
+    }
+    Scan("Try<int>", results);
+  }
+
+  {
+    std::vector<Try<void>> results;
+    results.reserve(kResults);
+    for (size_t i = 0; i < kResults; i++) {
+      if (i % kErrorEvery == 0) {
+        results.emplace_back(Error(ErrorCode(kFailed)));
+      } else {
+        results.emplace_back();
+      }
+    }
+    Scan("Try<void>", results);
+  }
+}
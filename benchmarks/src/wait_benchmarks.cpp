@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ *  File:   wait_benchmarks.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Wake-up latency and consumer CPU cost of `Future::Wait`
+ *              against spin-polling `IsReady`.
+ *
+ ******************************************************************************/
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "benchmark.hpp"
+#include "future.hpp"
+
+using namespace dien;
+using namespace dien::bench;
+
+namespace
+{
+
+const int kRounds = 2000;
+
+typedef std::chrono::steady_clock Clock;
+
+int64_t NowNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+double ThreadCpuNanos()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// A producer thread fulfils each round's promise with its own timestamp
+// after a short delay; the consumer measures the time until it notices.
+template <class WaitFn>
+void Run(const std::string& name, WaitFn wait)
+{
+  std::atomic<Promise<int64_t>*> handoff(nullptr);
+  std::vector<double> latencies;
+  latencies.reserve(kRounds);
+
+  std::thread producer([&]() {
+    for (int round = 0; round < kRounds; round++) {
+      Promise<int64_t>* promise;
+      while (!(promise = handoff.exchange(nullptr))) {
+        std::this_thread::yield();
+      }
+
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      promise->SetValue(NowNanos());
+    }
+  });
+
+  double cpu_start = ThreadCpuNanos();
+
+  for (int round = 0; round < kRounds; round++) {
+    Promise<int64_t> promise;
+    Future<int64_t> f = promise.GetFuture();
+    handoff.store(&promise);
+
+    wait(f);
+    latencies.push_back(NowNanos() - f.Value());
+  }
+
+  double cpu = ThreadCpuNanos() - cpu_start;
+  producer.join();
+
+  std::sort(latencies.begin(), latencies.end());
+
+  Report("FutureWakeUp", name + " latency p50", latencies[kRounds / 2], "ns");
+  Report("FutureWakeUp", name + " latency p99",
+         latencies[kRounds * 99 / 100], "ns");
+  Report("FutureWakeUp", name + " consumer cpu", cpu / kRounds, "ns/round");
+}
+
+}  // namespace
+
+DIEN_BENCHMARK(FutureWakeUp)
+{
+  Run("spin-poll IsReady", [](Future<int64_t>& f) {
+    while (!f.IsReady()) {}
+  });
+
+  Run("Wait (spin then park)", [](Future<int64_t>& f) { f.Wait(); });
+}
@@ -0,0 +1,336 @@
+/******************************************************************************
+ *
+ *  File:   allocator.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Pluggable allocation of small, fixed size blocks such as
+ *              `SharedData` nodes. By default every thread owns a free-list
+ *              pool; blocks freed by other threads are handed back to their
+ *              owner through a lock-free remote-free stack.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace dien
+{
+
+class BlockAllocator
+{
+ public:
+  virtual ~BlockAllocator()
+  {
+  }
+
+  virtual void* Allocate(size_t size) = 0;
+
+  // `size` is the size the block was allocated with.
+  virtual void Deallocate(void* block, size_t size) = 0;
+};  // class BlockAllocator
+
+// Plain global operator new/delete.
+class MallocAllocator : public BlockAllocator
+{
+ public:
+  static MallocAllocator& Instance()
+  {
+    static MallocAllocator instance;
+    return instance;
+  }
+
+  void* Allocate(size_t size) override
+  {
+    return ::operator new(size);
+  }
+
+  void Deallocate(void* block, size_t) override
+  {
+    ::operator delete(block);
+  }
+};  // class MallocAllocator
+
+// Per-thread pool with one free list per 16 byte size class. Only the owning
+// thread touches the free lists; other threads push freed blocks onto
+// `remote_`, which the owner drains when a free list runs dry.
+//
+// When the owner exits it marks `remote_` dead and releases everything it
+// holds. Blocks still alive elsewhere are then freed straight to the heap by
+// whoever releases them, and the last of them deletes the pool.
+class PoolAllocator : public BlockAllocator
+{
+ public:
+  static const size_t kGranularity = 16;
+  static const size_t kMaxPooledSize = 512;
+  static const size_t kMaxCachedPerClass = 1024;
+
+  // This thread's pool, or nullptr once the thread is being torn down.
+  static PoolAllocator* Local()
+  {
+    return Holder().pool;
+  }
+
+  void* Allocate(size_t size) override
+  {
+    live_++;
+
+    if (size > kMaxPooledSize) {
+      return ::operator new(size);
+    }
+
+    size_t index = ClassOf(size);
+    if (!free_[index]) {
+      DrainRemote();
+    }
+
+    FreeBlock* block = free_[index];
+    if (!block) {
+      return ::operator new(ClassSize(index));
+    }
+
+    free_[index] = block->next;
+    cached_[index]--;
+
+    return block;
+  }
+
+  void Deallocate(void* block, size_t size) override
+  {
+    if (Local() == this) {
+      live_--;
+      Release(block, size);
+      return;
+    }
+
+    RemoteBlock* node = static_cast<RemoteBlock*>(block);
+    node->size = size;
+
+    RemoteBlock* head = remote_.load(std::memory_order_relaxed);
+    do {
+      if (head == Dead()) {
+        ::operator delete(block);
+        if (orphans_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          delete this;
+        }
+        return;
+      }
+
+      node->next = head;
+    } while (!remote_.compare_exchange_weak(head, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+  }
+
+ private:
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  struct RemoteBlock
+  {
+    RemoteBlock* next;
+    size_t size;
+  };
+
+  static const size_t kClasses = kMaxPooledSize / kGranularity;
+
+  struct LocalHolder
+  {
+    LocalHolder() : pool(new PoolAllocator())
+    {
+    }
+
+    ~LocalHolder()
+    {
+      PoolAllocator* retired = pool;
+      pool = nullptr;
+      retired->Retire();
+    }
+
+    PoolAllocator* pool;
+  };
+
+  static LocalHolder& Holder()
+  {
+    static thread_local LocalHolder holder;
+    return holder;
+  }
+
+  static RemoteBlock* Dead()
+  {
+    return reinterpret_cast<RemoteBlock*>(uintptr_t(1));
+  }
+
+  static size_t ClassOf(size_t size)
+  {
+    return (size + kGranularity - 1) / kGranularity - 1;
+  }
+
+  static size_t ClassSize(size_t index)
+  {
+    return (index + 1) * kGranularity;
+  }
+
+  PoolAllocator() : live_(0), remote_(nullptr), orphans_(0)
+  {
+    for (size_t i = 0; i < kClasses; i++) {
+      free_[i] = nullptr;
+      cached_[i] = 0;
+    }
+  }
+
+  // Owner only. `size` must have been produced by `Allocate`.
+  void Release(void* block, size_t size)
+  {
+    if (size > kMaxPooledSize) {
+      ::operator delete(block);
+      return;
+    }
+
+    size_t index = ClassOf(size);
+    if (cached_[index] >= kMaxCachedPerClass) {
+      ::operator delete(block);
+      return;
+    }
+
+    FreeBlock* free_block = static_cast<FreeBlock*>(block);
+    free_block->next = free_[index];
+    free_[index] = free_block;
+    cached_[index]++;
+  }
+
+  void DrainRemote()
+  {
+    if (!remote_.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    ReleaseRemote(remote_.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  void ReleaseRemote(RemoteBlock* node)
+  {
+    while (node) {
+      RemoteBlock* next = node->next;
+      live_--;
+      Release(node, node->size);
+      node = next;
+    }
+  }
+
+  void Retire()
+  {
+    ReleaseRemote(remote_.exchange(Dead(), std::memory_order_acquire));
+
+    for (size_t i = 0; i < kClasses; i++) {
+      while (free_[i]) {
+        FreeBlock* next = free_[i]->next;
+        ::operator delete(free_[i]);
+        free_[i] = next;
+      }
+    }
+
+    // Remote frees that already saw the dead marker may have gone first and
+    // driven the count negative.
+    long outstanding = live_;
+    if (orphans_.fetch_add(outstanding, std::memory_order_acq_rel) +
+            outstanding ==
+        0) {
+      delete this;
+    }
+  }
+
+  FreeBlock* free_[kClasses];
+  size_t cached_[kClasses];
+  long live_;
+
+  std::atomic<RemoteBlock*> remote_;
+  std::atomic<long> orphans_;
+};  // class PoolAllocator
+
+namespace detail
+{
+
+inline std::atomic<BlockAllocator*>& AllocatorHook()
+{
+  static std::atomic<BlockAllocator*> hook(nullptr);
+  return hook;
+}
+
+// Every block starts with a header naming the allocator that produced it, so
+// the hook can be swapped while blocks are alive.
+struct BlockHeader
+{
+  BlockAllocator* allocator;
+};
+
+static const size_t kBlockHeaderSize = alignof(std::max_align_t);
+
+static_assert(sizeof(BlockHeader) <= kBlockHeaderSize,
+              "block header does not fit its slot");
+
+}  // namespace detail
+
+// Installs the allocator used for new blocks and returns the previous one.
+// nullptr selects the per-thread pools.
+inline BlockAllocator* SetBlockAllocator(BlockAllocator* allocator)
+{
+  return detail::AllocatorHook().exchange(allocator);
+}
+
+inline void* AllocateBlock(size_t size)
+{
+  BlockAllocator* allocator =
+      detail::AllocatorHook().load(std::memory_order_relaxed);
+  if (!allocator) {
+    allocator = PoolAllocator::Local();
+  }
+
+  if (!allocator) {
+    allocator = &MallocAllocator::Instance();
+  }
+
+  size += detail::kBlockHeaderSize;
+
+  void* block = allocator->Allocate(size);
+  static_cast<detail::BlockHeader*>(block)->allocator = allocator;
+
+  return static_cast<char*>(block) + detail::kBlockHeaderSize;
+}
+
+inline void DeallocateBlock(void* p, size_t size)
+{
+  void* block = static_cast<char*>(p) - detail::kBlockHeaderSize;
+
+  static_cast<detail::BlockHeader*>(block)->allocator->Deallocate(
+      block, size + detail::kBlockHeaderSize);
+}
+
+// For types aligned beyond the block header, such as cache-line aligned
+// ones. Over-allocates by `align` and keeps the distance back to the block
+// in the byte just before the returned pointer.
+inline void* AllocateAlignedBlock(size_t size, size_t align)
+{
+  assert(align <= 128 && (align & (align - 1)) == 0);
+
+  char* block = static_cast<char*>(AllocateBlock(size + align));
+  char* p = reinterpret_cast<char*>(
+      (reinterpret_cast<uintptr_t>(block) + align) & ~(align - 1));
+  p[-1] = static_cast<char>(p - block);
+
+  return p;
+}
+
+inline void DeallocateAlignedBlock(void* p, size_t size, size_t align)
+{
+  char* q = static_cast<char*>(p);
+  DeallocateBlock(q - static_cast<unsigned char>(q[-1]), size + align);
+}
+
+}  // namespace dien
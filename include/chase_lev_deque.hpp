@@ -0,0 +1,174 @@
+/******************************************************************************
+ *
+ *  File:   chase_lev_deque.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Chase-Lev work-stealing deque ("Correct and Efficient
+ *              Work-Stealing for Weak Memory Models", Le et al., PPoPP'13).
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace dien
+{
+
+// The owner pushes and pops at the bottom (LIFO); any thread may steal from
+// the top (FIFO). `T` is copied racily and so must be trivially copyable,
+// typically a pointer.
+template <class T>
+class ChaseLevDeque
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "ChaseLevDeque elements must be trivially copyable");
+
+ public:
+  explicit ChaseLevDeque(size_t capacity = 256)
+      : top_(0), bottom_(0), array_(new Array(RoundUp(capacity)))
+  {
+  }
+
+  ~ChaseLevDeque()
+  {
+    delete array_.load(std::memory_order_relaxed);
+    for (Array* array : retired_) {
+      delete array;
+    }
+  }
+
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+  // Owner only.
+  void Push(T value)
+  {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Array* array = array_.load(std::memory_order_relaxed);
+
+    if (bottom - top > static_cast<int64_t>(array->mask)) {
+      array = Grow(array, top, bottom);
+    }
+
+    array->Put(bottom, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Takes the most recently pushed element.
+  bool Pop(T& value)
+  {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    value = array->Get(bottom);
+    if (top == bottom) {
+      // Last element: race the thieves for it.
+      bool won = top_.compare_exchange_strong(
+          top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return won;
+    }
+
+    return true;
+  }
+
+  // Any thread. Takes the oldest element. May fail spuriously when racing
+  // with another thief or the owner.
+  bool Steal(T& value)
+  {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+      return false;
+    }
+
+    Array* array = array_.load(std::memory_order_acquire);
+    value = array->Get(top);
+
+    return top_.compare_exchange_strong(
+        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  // Approximate when called concurrently with Push/Pop/Steal.
+  bool Empty() const
+  {
+    return bottom_.load(std::memory_order_relaxed) <=
+           top_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Array
+  {
+    explicit Array(size_t capacity)
+        : mask(capacity - 1), slots(new std::atomic<T>[capacity])
+    {
+    }
+
+    ~Array()
+    {
+      delete[] slots;
+    }
+
+    T Get(int64_t index) const
+    {
+      return slots[index & mask].load(std::memory_order_relaxed);
+    }
+
+    void Put(int64_t index, T value)
+    {
+      slots[index & mask].store(value, std::memory_order_relaxed);
+    }
+
+    size_t mask;
+    std::atomic<T>* slots;
+  };
+
+  static size_t RoundUp(size_t capacity)
+  {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  // Thieves may still be reading the old array, so it is only freed with
+  // the deque.
+  Array* Grow(Array* array, int64_t top, int64_t bottom)
+  {
+    Array* bigger = new Array((array->mask + 1) * 2);
+    for (int64_t i = top; i < bottom; i++) {
+      bigger->Put(i, array->Get(i));
+    }
+
+    retired_.push_back(array);
+    array_.store(bigger, std::memory_order_release);
+
+    return bigger;
+  }
+
+  // Thieves hammer `top_`, the owner `bottom_`: keep them on separate lines.
+  std::atomic<int64_t> top_;
+  char pad_[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  std::vector<Array*> retired_;
+};  // class ChaseLevDeque
+
+}  // namespace dien
@@ -0,0 +1,609 @@
+/******************************************************************************
+ *
+ *  File:   collect.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Combinators joining many futures into one: `CollectAll`,
+ *              `CollectAny`, `CollectN`, `Reduce` and `UnorderedReduce`.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "allocator.hpp"
+#include "future.hpp"
+#include "index_sequence.hpp"
+#include "option.hpp"
+
+namespace dien
+{
+
+namespace detail
+{
+
+template <class InputIterator>
+using CollectValueType = typename std::iterator_traits<
+    InputIterator>::value_type::value_type;
+
+// Every combinator below allocates one context holding the output promise
+// and the pre-sized results, and attaches one callback per input future. The
+// callbacks share a single countdown; whichever brings it to zero owns the
+// context from then on.
+template <class T>
+struct CollectAllContext
+{
+  explicit CollectAllContext(size_t n) : results(n), remaining(n)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void Done()
+  {
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      promise.SetValue(std::move(results));
+      delete this;
+    }
+  }
+
+  Promise<std::vector<Try<T>>> promise;
+  std::vector<Try<T>> results;
+  std::atomic<size_t> remaining;
+};
+
+template <class... Ts>
+struct CollectAllTupleContext
+{
+  CollectAllTupleContext() : remaining(sizeof...(Ts))
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void Done()
+  {
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      promise.SetValue(std::move(results));
+      delete this;
+    }
+  }
+
+  template <size_t... Is>
+  void Attach(IndexSequence<Is...>, Future<Ts>&... futures)
+  {
+    int expand[] = {0, (AttachOne<Is>(futures), 0)...};
+    (void)expand;
+  }
+
+  template <size_t I, class T>
+  void AttachOne(Future<T>& future)
+  {
+    future.SetCallback_([this](Try<T>&& t) {
+      std::get<I>(results) = std::move(t);
+      Done();
+    });
+  }
+
+  Promise<std::tuple<Try<Ts>...>> promise;
+  std::tuple<Try<Ts>...> results;
+  std::atomic<size_t> remaining;
+};
+
+// The first completion claims the result; the context lives until every
+// input has reported.
+template <class T>
+struct CollectAnyContext
+{
+  explicit CollectAnyContext(size_t n) : done(false), remaining(n)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void Complete(size_t index, Try<T>&& t)
+  {
+    if (!done.exchange(true, std::memory_order_relaxed)) {
+      promise.SetValue(std::make_pair(index, std::move(t)));
+    }
+
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  Promise<std::pair<size_t, Try<T>>> promise;
+  std::atomic<bool> done;
+  std::atomic<size_t> remaining;
+};
+
+// Completions claim slots in arrival order; the n-th writer to finish
+// fulfils the promise.
+template <class T>
+struct CollectNContext
+{
+  CollectNContext(size_t inputs, size_t n)
+      : wanted(n), results(n), claimed(0), written(0), remaining(inputs)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void Complete(size_t index, Try<T>&& t)
+  {
+    size_t slot = claimed.fetch_add(1, std::memory_order_relaxed);
+    if (slot < wanted) {
+      results[slot].first = index;
+      results[slot].second = std::move(t);
+
+      if (written.fetch_add(1, std::memory_order_acq_rel) + 1 == wanted) {
+        promise.SetValue(std::move(results));
+      }
+    }
+
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  const size_t wanted;
+  Promise<std::vector<std::pair<size_t, Try<T>>>> promise;
+  std::vector<std::pair<size_t, Try<T>>> results;
+  std::atomic<size_t> claimed;
+  std::atomic<size_t> written;
+  std::atomic<size_t> remaining;
+};
+
+// Calls a reduce function with the accumulator and a value, or with the
+// accumulator alone for `void`.
+template <class T>
+struct ReduceApply
+{
+  template <class F, class V>
+  static V Apply(F& func, V&& accumulator, Try<T>&& t)
+  {
+    return func(std::move(accumulator), std::move(t).Value());
+  }
+};
+
+template <>
+struct ReduceApply<void>
+{
+  template <class F, class V>
+  static V Apply(F& func, V&& accumulator, Try<void>&&)
+  {
+    return func(std::move(accumulator));
+  }
+};
+
+// The fold shared by both reduces. Only one thread folds at a time, the
+// "folder": an arrival that finds nobody folding (`announced` was 0) becomes
+// the folder and keeps going until a compare-and-swap of `announced` back to
+// 0 shows nothing else arrived meanwhile. Arrivals that find a folder leave
+// their result to it and return, so a result costs one or two RMWs and no
+// lock, and nobody waits on a slow `func` but the thread already running it.
+template <class T, class V, class F>
+struct ReduceContext
+{
+  ReduceContext(size_t n, V&& init, F f)
+      : accumulator(std::move(init)),
+        func(std::move(f)),
+        remaining(n),
+        failed(false),
+        announced(0)
+  {
+  }
+
+  // Folder only. The first error fails the reduce; results after it are
+  // dropped. Returns whether that was the last input.
+  bool Fold(Try<T>&& t)
+  {
+    if (!failed) {
+      if (t.HasError()) {
+        failed = true;
+        promise.SetError(std::move(t.GetError()));
+      } else {
+        accumulator = ReduceApply<T>::Apply(func, std::move(accumulator),
+                                            std::move(t));
+      }
+    }
+
+    return --remaining == 0;
+  }
+
+  // Folder, after the last input: nothing can arrive any more.
+  void Finish()
+  {
+    if (!failed) {
+      promise.SetValue(std::move(accumulator));
+    }
+  }
+
+  Promise<V> promise;
+  V accumulator;
+  F func;
+  size_t remaining;
+  bool failed;
+  std::atomic<size_t> announced;
+};
+
+// A result waiting for `OrderedReduceContext` to fold it. `ready` is what
+// the folder looks at: the result itself may still be being written.
+template <class T>
+struct ReduceSlot
+{
+  Option<Try<T>> result;
+  std::atomic<bool> ready{false};
+};
+
+// Folds in input order: a result waits in its slot until every earlier one
+// has been folded, and is released as soon as it is. A slot may be folded
+// before its arrival has announced it, so the folder that folds the last
+// input does not free the context: the last arrival to leave does.
+template <class T, class V, class F>
+struct OrderedReduceContext : public ReduceContext<T, V, F>
+{
+  OrderedReduceContext(size_t n, V&& init, F f)
+      : ReduceContext<T, V, F>(n, std::move(init), std::move(f)),
+        slots(n),
+        next(0),
+        inside(n)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void Arrive(size_t index, Try<T>&& t)
+  {
+    Store(index, std::move(t));
+    Announce();
+  }
+
+  // The two halves of `Arrive`.
+  void Store(size_t index, Try<T>&& t)
+  {
+    slots[index].result.Emplace(std::move(t));
+    slots[index].ready.store(true, std::memory_order_release);
+  }
+
+  void Announce()
+  {
+    if (this->announced.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      FoldReady();
+    }
+
+    if (inside.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // The arrival whose announcement finds nobody folding.
+  void FoldReady()
+  {
+    bool last = false;
+    size_t seen = this->announced.load(std::memory_order_acquire);
+    for (;;) {
+      while (next < slots.size() &&
+             slots[next].ready.load(std::memory_order_acquire)) {
+        last = this->Fold(std::move(slots[next].result.Value()));
+        slots[next].result.Clear();
+        next++;
+      }
+
+      if (this->announced.compare_exchange_strong(
+              seen, 0, std::memory_order_acq_rel)) {
+        break;
+      }
+    }
+
+    if (last) {
+      this->Finish();
+    }
+  }
+
+  std::vector<ReduceSlot<T>> slots;
+  // Folder only.
+  size_t next;
+  // Arrivals that have not left `Announce` yet.
+  std::atomic<size_t> inside;
+};
+
+// Folds in completion order. A result that finds a folder at work is pushed
+// onto `incoming` for it; the folder takes the whole list at a time.
+template <class T, class V, class F>
+struct UnorderedReduceContext : public ReduceContext<T, V, F>
+{
+  UnorderedReduceContext(size_t n, V&& init, F f)
+      : ReduceContext<T, V, F>(n, std::move(init), std::move(f)),
+        incoming(nullptr)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  struct Node
+  {
+    explicit Node(Try<T>&& t) : result(std::move(t)), next(nullptr)
+    {
+    }
+
+    static void* operator new(size_t size)
+    {
+      return AllocateBlock(size);
+    }
+
+    static void operator delete(void* p, size_t size)
+    {
+      DeallocateBlock(p, size);
+    }
+
+    Try<T> result;
+    Node* next;
+  };
+
+  void Arrive(Try<T>&& t)
+  {
+    if (this->announced.fetch_add(1, std::memory_order_acq_rel) != 0) {
+      Node* node = new Node(std::move(t));
+      node->next = incoming.load(std::memory_order_relaxed);
+      while (!incoming.compare_exchange_weak(node->next, node,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+      }
+      return;
+    }
+
+    bool last = this->Fold(std::move(t));
+    size_t folded = 1;
+    for (;;) {
+      size_t expected = folded;
+      if (this->announced.compare_exchange_strong(
+              expected, 0, std::memory_order_acq_rel)) {
+        break;
+      }
+
+      // Announced but maybe not pushed yet.
+      Node* node = incoming.exchange(nullptr, std::memory_order_acquire);
+      if (!node) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      // Oldest first.
+      Node* ordered = nullptr;
+      while (node) {
+        Node* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+      }
+
+      while (ordered) {
+        Node* next = ordered->next;
+        last = this->Fold(std::move(ordered->result));
+        delete ordered;
+        ordered = next;
+        folded++;
+      }
+    }
+
+    if (last) {
+      this->Finish();
+      delete this;
+    }
+  }
+
+  std::atomic<Node*> incoming;
+};
+
+}  // namespace detail
+
+// Completes once every future in [first, last) has, with their results in
+// input order. Never fails itself: errors are reported per element. The
+// input futures are consumed.
+template <class InputIterator,
+          class T = detail::CollectValueType<InputIterator>>
+Future<std::vector<Try<T>>> CollectAll(InputIterator first,
+                                       InputIterator last)
+{
+  size_t n = std::distance(first, last);
+  if (n == 0) {
+    return Future<std::vector<Try<T>>>(std::vector<Try<T>>());
+  }
+
+  auto context = new detail::CollectAllContext<T>(n);
+  Future<std::vector<Try<T>>> f = context->promise.GetFuture();
+
+  for (size_t i = 0; first != last; ++first, ++i) {
+    first->SetCallback_([context, i](Try<T>&& t) {
+      context->results[i] = std::move(t);
+      context->Done();
+    });
+  }
+
+  return f;
+}
+
+// Variadic form, for futures of different types.
+template <class... Ts>
+Future<std::tuple<Try<Ts>...>> CollectAll(Future<Ts>&&... futures)
+{
+  static_assert(sizeof...(Ts) > 0, "CollectAll needs at least one future");
+
+  auto context = new detail::CollectAllTupleContext<Ts...>();
+  Future<std::tuple<Try<Ts>...>> f = context->promise.GetFuture();
+
+  context->Attach(
+      typename detail::MakeIndexSequence<sizeof...(Ts)>::type(),
+      futures...);
+
+  return f;
+}
+
+// Completes with the index and result of the first future in [first, last)
+// to complete. Fails if the range is empty.
+template <class InputIterator,
+          class T = detail::CollectValueType<InputIterator>>
+Future<std::pair<size_t, Try<T>>> CollectAny(InputIterator first,
+                                             InputIterator last)
+{
+  size_t n = std::distance(first, last);
+  if (n == 0) {
+    return Future<std::pair<size_t, Try<T>>>(
+        FailedFuture(Error("CollectAny called with no futures")));
+  }
+
+  auto context = new detail::CollectAnyContext<T>(n);
+  Future<std::pair<size_t, Try<T>>> f = context->promise.GetFuture();
+
+  for (size_t i = 0; first != last; ++first, ++i) {
+    first->SetCallback_(
+        [context, i](Try<T>&& t) { context->Complete(i, std::move(t)); });
+  }
+
+  return f;
+}
+
+// Completes with the index and result of the first `n` futures in
+// [first, last) to complete, in completion order. Fails if the range holds
+// fewer than `n` futures.
+template <class InputIterator,
+          class T = detail::CollectValueType<InputIterator>>
+Future<std::vector<std::pair<size_t, Try<T>>>> CollectN(InputIterator first,
+                                                        InputIterator last,
+                                                        size_t n)
+{
+  typedef std::vector<std::pair<size_t, Try<T>>> Result;
+
+  size_t inputs = std::distance(first, last);
+  if (inputs < n) {
+    return Future<Result>(
+        FailedFuture(Error("CollectN called with too few futures")));
+  }
+
+  if (n == 0) {
+    return Future<Result>(Result());
+  }
+
+  auto context = new detail::CollectNContext<T>(inputs, n);
+  Future<Result> f = context->promise.GetFuture();
+
+  for (size_t i = 0; first != last; ++first, ++i) {
+    first->SetCallback_(
+        [context, i](Try<T>&& t) { context->Complete(i, std::move(t)); });
+  }
+
+  return f;
+}
+
+// Folds the results of the futures in [first, last) into `init` with
+// `func(V&& accumulator, T&& value)` (`func(V&&)` for futures of `void`),
+// which returns the new accumulator. Values are folded in input order, each
+// as soon as it and all those before it are in; one that arrives early waits
+// in a slot, so memory is proportional to how far ahead of the fold the
+// inputs complete. Fails with the first error in input order. The input
+// futures are consumed.
+template <class InputIterator, class V, class F,
+          class T = detail::CollectValueType<InputIterator>>
+Future<V> Reduce(InputIterator first, InputIterator last, V init, F&& func)
+{
+  size_t n = std::distance(first, last);
+  if (n == 0) {
+    return Future<V>(std::move(init));
+  }
+
+  typedef detail::OrderedReduceContext<T, V, typename std::decay<F>::type>
+      Context;
+  Context* context = new Context(n, std::move(init), std::forward<F>(func));
+  Future<V> f = context->promise.GetFuture();
+
+  for (size_t i = 0; first != last; ++first, ++i) {
+    first->SetCallback_(
+        [context, i](Try<T>&& t) { context->Arrive(i, std::move(t)); });
+  }
+
+  return f;
+}
+
+// As `Reduce`, folding each value as it arrives, in completion order. Keeps
+// nothing per input but what is in flight, so memory does not grow with the
+// number of inputs. `func` must not depend on the order of the values. Fails
+// with the first error to arrive.
+template <class InputIterator, class V, class F,
+          class T = detail::CollectValueType<InputIterator>>
+Future<V> UnorderedReduce(InputIterator first, InputIterator last, V init,
+                          F&& func)
+{
+  size_t n = std::distance(first, last);
+  if (n == 0) {
+    return Future<V>(std::move(init));
+  }
+
+  typedef detail::UnorderedReduceContext<T, V, typename std::decay<F>::type>
+      Context;
+  Context* context = new Context(n, std::move(init), std::forward<F>(func));
+  Future<V> f = context->promise.GetFuture();
+
+  for (; first != last; ++first) {
+    first->SetCallback_(
+        [context](Try<T>&& t) { context->Arrive(std::move(t)); });
+  }
+
+  return f;
+}
+
+}  // namespace dien
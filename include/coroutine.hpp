@@ -0,0 +1,317 @@
+/******************************************************************************
+ *
+ *  File:   coroutine.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: C++20 coroutine integration: `co_await` on a `Future` and a
+ *              lazy `Task` coroutine type. Both report errors as `Try`, never
+ *              by throwing. Everything here is compiled only when the
+ *              compiler supports coroutines (`DIEN_HAS_COROUTINES`).
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define DIEN_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifndef DIEN_HAS_COROUTINES
+#define DIEN_HAS_COROUTINES 0
+#endif
+
+#if DIEN_HAS_COROUTINES
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "allocator.hpp"
+#include "future.hpp"
+#include "option.hpp"
+
+namespace dien
+{
+
+template <class T>
+class Task;
+
+namespace detail
+{
+
+// Suspends the awaiting coroutine until the future is fulfilled and resumes
+// it from the callback, on whichever thread fulfils the future (or on the
+// future's executor, see `Future::Via`). The callback may also run inside
+// `SetCallback_` when the future is already ready; `resumed_` elects who
+// continues the coroutine.
+template <class T>
+class FutureAwaiter
+{
+ public:
+  explicit FutureAwaiter(Future<T>&& future) : future_(std::move(future))
+  {
+  }
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle)
+  {
+    future_.SetCallback_([this, handle](Try<T>&& t) {
+      result_.Emplace(std::move(t));
+      if (resumed_.exchange(true, std::memory_order_acq_rel)) {
+        handle.resume();
+      }
+    });
+
+    return !resumed_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  Try<T> await_resume()
+  {
+    return std::move(result_.Value());
+  }
+
+ private:
+  Future<T> future_;
+  Option<Try<T>> result_;
+  std::atomic<bool> resumed_{false};
+};  // class FutureAwaiter
+
+// State shared by the `Task<T>` and `Task<void>` promises. Frames come from
+// the block pools, like SharedData.
+template <class T>
+class TaskPromiseBase
+{
+ public:
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  // Lazy: nothing runs until the task is awaited or `Run`.
+  std::suspend_always initial_suspend() noexcept
+  {
+    return {};
+  }
+
+  // Hands control to the awaiting coroutine, if any. A task started with
+  // `Run` has none: it fulfils its Promise and frees its own frame.
+  struct FinalAwaiter
+  {
+    bool await_ready() noexcept
+    {
+      return false;
+    }
+
+    template <class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle)
+        noexcept
+    {
+      TaskPromiseBase& promise = handle.promise();
+      if (promise.continuation_) {
+        return promise.continuation_;
+      }
+
+      if (promise.completion_) {
+        Promise<T> completion = std::move(promise.completion_.Value());
+        Try<T> result = std::move(promise.result_.Value());
+        handle.destroy();
+        Fulfil(completion, std::move(result));
+      }
+
+      return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept
+    {
+    }
+  };
+
+  FinalAwaiter final_suspend() noexcept
+  {
+    return {};
+  }
+
+  // dien reports errors as values; nothing should throw through a task.
+  void unhandled_exception() noexcept
+  {
+    std::terminate();
+  }
+
+ protected:
+  template <class>
+  friend class dien::Task;
+
+  std::coroutine_handle<> continuation_;
+  Option<Promise<T>> completion_;
+  Option<Try<T>> result_;
+};  // class TaskPromiseBase
+
+template <class T>
+class TaskPromise : public TaskPromiseBase<T>
+{
+ public:
+  Task<T> get_return_object();
+
+  // Anything a `Try<T>` can be built from: a value, an `Error` or a
+  // `Try<T>`.
+  template <class U>
+  void return_value(U&& value)
+  {
+    this->result_.Emplace(Try<T>(std::forward<U>(value)));
+  }
+};  // class TaskPromise
+
+// `co_return;` only, so a `Task<void>` cannot fail; return a `Try<void>`
+// from a `Task<Try<void>>` to report errors instead.
+template <>
+class TaskPromise<void> : public TaskPromiseBase<void>
+{
+ public:
+  Task<void> get_return_object();
+
+  void return_void()
+  {
+    result_.Emplace(Try<void>());
+  }
+};  // class TaskPromise
+
+}  // namespace detail
+
+// A lazily started coroutine producing a `Try<T>`. `co_await` it from
+// another coroutine, or `Run` it to get a `Future<T>`.
+//
+//   Task<int> Add(Future<int> a, Future<int> b)
+//   {
+//     Try<int> x = co_await std::move(a);
+//     Try<int> y = co_await std::move(b);
+//     if (x.HasError()) co_return std::move(x);
+//     if (y.HasError()) co_return std::move(y);
+//     co_return x.Value() + y.Value();
+//   }
+template <class T>
+class Task
+{
+ public:
+  typedef detail::TaskPromise<T> promise_type;
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  Task(Task&& other) noexcept : handle_(other.handle_)
+  {
+    other.handle_ = nullptr;
+  }
+
+  Task& operator=(Task&& other) noexcept
+  {
+    std::swap(handle_, other.handle_);
+    return *this;
+  }
+
+  ~Task()
+  {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  class Awaiter
+  {
+   public:
+    explicit Awaiter(Handle handle) : handle_(handle)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    // Starts the task; its final suspend resumes us.
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+    {
+      handle_.promise().continuation_ = awaiting;
+      return handle_;
+    }
+
+    Try<T> await_resume()
+    {
+      return std::move(handle_.promise().result_.Value());
+    }
+
+   private:
+    Handle handle_;
+  };  // class Awaiter
+
+  Awaiter operator co_await() &&
+  {
+    assert(handle_);
+    return Awaiter(handle_);
+  }
+
+  // Starts the task on the calling thread. The returned future is fulfilled
+  // when it finishes; the frame then frees itself.
+  Future<T> Run() &&
+  {
+    assert(handle_);
+
+    Promise<T> promise;
+    Future<T> f = promise.GetFuture();
+
+    Handle handle = handle_;
+    handle_ = nullptr;
+    handle.promise().completion_.Emplace(std::move(promise));
+    handle.resume();
+
+    return f;
+  }
+
+ private:
+  friend class detail::TaskPromise<T>;
+
+  explicit Task(Handle handle) : handle_(handle)
+  {
+  }
+
+  Handle handle_;
+};  // class Task
+
+namespace detail
+{
+
+template <class T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+  return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+  return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+}  // namespace detail
+
+// `co_await std::move(future)` yields the future's `Try<T>`.
+template <class T>
+detail::FutureAwaiter<T> operator co_await(Future<T>&& future)
+{
+  return detail::FutureAwaiter<T>(std::move(future));
+}
+
+}  // namespace dien
+
+#endif  // DIEN_HAS_COROUTINES
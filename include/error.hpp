@@ -8,58 +8,259 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
-#include <memory>
+#include <atomic>
+#include <cassert>
+#include <new>
 #include <string>
-#include <stack>
+#include <type_traits>
+#include <utility>
+
+#include "allocator.hpp"
+#include "index_sequence.hpp"
 
 namespace dien
 {
 
 enum ErrorCodes {
   kFailed,
+  kTimedOut,
+  kBrokenPromise,
+  kCancelled,
+};
+
+// Codes below this bound can carry an interned message.
+const int kMaxInternedCode = 256;
+
+namespace detail
+{
+
+struct InternedMessages
+{
+  InternedMessages()
+  {
+    for (auto& message : messages) {
+      message.store(nullptr, std::memory_order_relaxed);
+    }
+
+    messages[kFailed].store("failed", std::memory_order_relaxed);
+    messages[kTimedOut].store("timed out", std::memory_order_relaxed);
+    messages[kBrokenPromise].store("broken promise",
+                                   std::memory_order_relaxed);
+    messages[kCancelled].store("cancelled", std::memory_order_relaxed);
+  }
+
+  std::atomic<const char*> messages[kMaxInternedCode];
+};
+
+inline std::atomic<const char*>& InternedMessage(int code)
+{
+  static InternedMessages table;
+  return table.messages[code];
+}
+
+// Numbers, enums and non-string pointers can be copied into an `ErrorCode`
+// and formatted later. Strings are formatted straight away: the text they
+// point to may be gone by the time anyone asks for the message.
+template <class T>
+struct IsDeferrableArg
+    : std::integral_constant<
+          bool,
+          (std::is_arithmetic<T>::value || std::is_enum<T>::value ||
+           (std::is_pointer<T>::value &&
+            !std::is_same<typename std::remove_cv<
+                              typename std::remove_pointer<T>::type>::type,
+                          char>::value)) &&
+              sizeof(T) <= sizeof(uint64_t)>
+{};
+
+template <class... Args>
+struct AllDeferrableArgs : std::true_type
+{};
+
+template <class T, class... Args>
+struct AllDeferrableArgs<T, Args...>
+    : std::integral_constant<bool, IsDeferrableArg<T>::value &&
+                                       AllDeferrableArgs<Args...>::value>
+{};
+
+template <class T>
+void StoreFormatArg(uint64_t* slot, T arg)
+{
+  memcpy(slot, &arg, sizeof(T));
+}
+
+template <class T>
+T LoadFormatArg(const uint64_t& slot)
+{
+  T arg;
+  memcpy(&arg, &slot, sizeof(T));
+  return arg;
+}
+
+// Formats a captured argument pack; one instantiation per argument list.
+template <class... Args>
+struct DeferredFormat
+{
+  static int Format(char* out, size_t size, const char* fmt,
+                    const uint64_t* args)
+  {
+    return Call(out, size, fmt, args,
+                typename MakeIndexSequence<sizeof...(Args)>::type());
+  }
+
+  template <size_t... Is>
+  static int Call(char* out, size_t size, const char* fmt,
+                  const uint64_t* args, IndexSequence<Is...>)
+  {
+    return snprintf(out, size, fmt, LoadFormatArg<Args>(args[Is])...);
+  }
+};
+
+}  // namespace detail
+
+// Registers the message that `ErrorCode(code)` reports. `message` is not
+// copied and must outlive every error carrying `code`; a string literal is
+// the usual choice.
+inline void InternErrorCode(int code, const char* message)
+{
+  assert(code >= 0 && code < kMaxInternedCode);
+  detail::InternedMessage(code).store(message, std::memory_order_release);
+}
+
+// Marks a message that lives for the whole program (a string literal), so
+// `ErrorCode` keeps the pointer instead of copying the text.
+struct StaticMessage
+{
+  explicit StaticMessage(const char* t) : text(t)
+  {
+  }
+
+  const char* text;
 };
 
+// Passed ahead of the format string to defer formatting (see `ErrorCode`).
+// Only for format strings that outlive the error, such as literals.
+struct FormatLaterTag
+{};
+
+const FormatLaterTag kFormatLater = FormatLaterTag();
+
+// An error code and its message. Messages that fit `kInlineMessage` bytes
+// are stored in place, static and interned messages by pointer; only longer
+// messages touch the heap.
+//
+// Formatted messages are formatted on construction. With `kFormatLater`,
+// formatting is deferred when every argument can be captured (see
+// `detail::IsDeferrableArg`) and there are at most `kDeferredArgs` of them:
+// the format string and arguments are kept, and formatted the first time
+// `Message()` is called. The format string must then outlive the error, as a
+// literal does.
 struct ErrorCode
 {
-  ErrorCode(int code, const std::string& msg) : error_code(code), message(msg)
+  static const size_t kInlineMessage = 48;
+  static const size_t kDeferredArgs = 3;
+
+  // Interned: the message is the one registered with `InternErrorCode`.
+  explicit ErrorCode(int code) : error_code(code), kind(kStatic)
   {
+    const char* message = nullptr;
+    if (code >= 0 && code < kMaxInternedCode) {
+      message = detail::InternedMessage(code).load(std::memory_order_acquire);
+    }
+    static_message = message ? message : "unknown error";
   }
 
-  ErrorCode(const char* fmt, ...) : error_code(kFailed)
+  ErrorCode(int code, StaticMessage message) : error_code(code), kind(kStatic)
   {
-    char buffer[256];
-    va_list args;
+    static_message = message.text;
+  }
 
-    va_start(args, fmt);
-    vsnprintf(buffer, 256, fmt, args);
+  ErrorCode(int code, const std::string& msg) : error_code(code)
+  {
+    SetMessage(msg.data(), msg.size());
+  }
 
-    message = buffer;
+  template <class... Args>
+  ErrorCode(const char* fmt, Args&&... args) : error_code(kFailed)
+  {
+    FormatNow(fmt, FormatArg(args)...);
+  }
 
-    va_end(args);
+  template <class... Args>
+  ErrorCode(int code, const char* fmt, Args&&... args) : error_code(code)
+  {
+    FormatNow(fmt, FormatArg(args)...);
   }
 
-  ErrorCode(int code, const char* fmt, ...) : error_code(code)
+  template <class... Args>
+  ErrorCode(int code, FormatLaterTag, const char* fmt, Args&&... args)
+      : error_code(code)
   {
-    char buffer[256];
-    va_list args;
+    Init(Deferrable<Args...>(), fmt, std::forward<Args>(args)...);
+  }
 
-    va_start(args, fmt);
-    vsnprintf(buffer, 256, fmt, args);
+  ErrorCode(const ErrorCode& other) : error_code(other.error_code)
+  {
+    CopyMessage(other);
+  }
 
-    message = buffer;
+  ErrorCode(ErrorCode&& other) noexcept : error_code(other.error_code)
+  {
+    StealMessage(other);
+  }
 
-    va_end(args);
+  ErrorCode& operator=(const ErrorCode& other)
+  {
+    if (this != &other) {
+      FreeMessage();
+      error_code = other.error_code;
+      CopyMessage(other);
+    }
+
+    return *this;
+  }
+
+  ErrorCode& operator=(ErrorCode&& other) noexcept
+  {
+    if (this != &other) {
+      FreeMessage();
+      error_code = other.error_code;
+      StealMessage(other);
+    }
+
+    return *this;
   }
 
-  std::string Message()
+  ~ErrorCode()
   {
-    return message;
+    FreeMessage();
   }
 
-  const std::string& Message() const
+  std::string Message() const
   {
-    return message;
+    return std::string(MessageData());
+  }
+
+  // Valid as long as this `ErrorCode`. Formats a deferred message on first
+  // use; concurrent callers agree on one copy.
+  const char* MessageData() const
+  {
+    switch (kind) {
+      case kStatic:
+        return static_message;
+      case kHeap:
+        return heap_message;
+      case kDeferred: {
+        const char* text = deferred.text.load(std::memory_order_acquire);
+        return text ? text : FormatDeferred();
+      }
+      default:
+        return inline_message;
+    }
   }
 
   int Code() const
@@ -68,22 +269,379 @@ struct ErrorCode
   }
 
  protected:
+  enum Kind : uint8_t {
+    kStatic,
+    kInline,
+    kHeap,
+    kDeferred
+  };
+
+  typedef int (*FormatFunction)(char*, size_t, const char*, const uint64_t*);
+
+  struct Deferred
+  {
+    const char* fmt;
+    FormatFunction format;
+    mutable std::atomic<char*> text;
+    uint64_t args[kDeferredArgs];
+  };
+
+  template <class... Args>
+  using Deferrable = std::integral_constant<
+      bool, (sizeof...(Args) > 0 && sizeof...(Args) <= kDeferredArgs) &&
+                detail::AllDeferrableArgs<
+                    typename std::decay<Args>::type...>::value>;
+
+  template <class... Args>
+  void Init(std::true_type, const char* fmt, Args... args)
+  {
+    kind = kDeferred;
+    new (&deferred) Deferred();
+    deferred.fmt = fmt;
+    deferred.format = &detail::DeferredFormat<Args...>::Format;
+
+    uint64_t* slot = deferred.args;
+    int expand[] = {0, (detail::StoreFormatArg(slot++, args), 0)...};
+    (void)expand;
+  }
+
+  template <class... Args>
+  void Init(std::false_type, const char* fmt, Args&&... args)
+  {
+    FormatNow(fmt, FormatArg(args)...);
+  }
+
+  template <class T>
+  static const T& FormatArg(const T& arg)
+  {
+    return arg;
+  }
+
+  static const char* FormatArg(const std::string& arg)
+  {
+    return arg.c_str();
+  }
+
+  const char* FormatDeferred() const
+  {
+    char scratch[256];
+    int length = deferred.format(scratch, sizeof(scratch), deferred.fmt,
+                                 deferred.args);
+    if (length < 0) {
+      length = 0;
+      scratch[0] = '\0';
+    }
+
+    char* text = new char[length + 1];
+    if (static_cast<size_t>(length) < sizeof(scratch)) {
+      memcpy(text, scratch, length + 1);
+    } else {
+      deferred.format(text, length + 1, deferred.fmt, deferred.args);
+    }
+
+    char* expected = nullptr;
+    if (!deferred.text.compare_exchange_strong(expected, text,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire)) {
+      delete[] text;
+      return expected;
+    }
+
+    return text;
+  }
+
+  void CopyDeferred(const Deferred& other, char* text)
+  {
+    kind = kDeferred;
+    new (&deferred) Deferred();
+    deferred.fmt = other.fmt;
+    deferred.format = other.format;
+    deferred.text.store(text, std::memory_order_relaxed);
+    memcpy(deferred.args, other.args, sizeof(deferred.args));
+  }
+
+  void SetMessage(const char* text, size_t length)
+  {
+    char* buffer = Reserve(length);
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+  }
+
+  void FormatNow(const char* fmt, ...)
+  {
+    va_list args;
+
+    va_start(args, fmt);
+    Format(fmt, args);
+    va_end(args);
+  }
+
+  void Format(const char* fmt, va_list args)
+  {
+    va_list retry;
+    va_copy(retry, args);
+
+    // Format once on the stack; only messages longer than the scratch
+    // buffer are formatted twice.
+    char scratch[256];
+    int length = vsnprintf(scratch, sizeof(scratch), fmt, args);
+    if (length < 0) {
+      SetMessage("", 0);
+    } else if (static_cast<size_t>(length) < sizeof(scratch)) {
+      SetMessage(scratch, length);
+    } else {
+      vsnprintf(Reserve(length), length + 1, fmt, retry);
+    }
+
+    va_end(retry);
+  }
+
+  // Returns room for `length` characters plus the terminator.
+  char* Reserve(size_t length)
+  {
+    if (length < kInlineMessage) {
+      kind = kInline;
+      return inline_message;
+    }
+
+    kind = kHeap;
+    heap_message = new char[length + 1];
+    return heap_message;
+  }
+
+  void CopyMessage(const ErrorCode& other)
+  {
+    if (other.kind == kStatic) {
+      kind = kStatic;
+      static_message = other.static_message;
+    } else if (other.kind == kDeferred) {
+      // The copy formats for itself if it is ever asked.
+      CopyDeferred(other.deferred, nullptr);
+    } else {
+      const char* text = other.MessageData();
+      SetMessage(text, strlen(text));
+    }
+  }
+
+  void StealMessage(ErrorCode& other)
+  {
+    kind = other.kind;
+    if (kind == kInline) {
+      memcpy(inline_message, other.inline_message, kInlineMessage);
+    } else if (kind == kDeferred) {
+      CopyDeferred(other.deferred,
+                   other.deferred.text.load(std::memory_order_relaxed));
+    } else {
+      // Both union members are pointers.
+      static_message = other.static_message;
+    }
+
+    other.kind = kStatic;
+    other.static_message = "";
+  }
+
+  void FreeMessage()
+  {
+    if (kind == kHeap) {
+      delete[] heap_message;
+    } else if (kind == kDeferred) {
+      delete[] deferred.text.load(std::memory_order_relaxed);
+    }
+  }
+
   int error_code;
-  std::string message;
+  Kind kind;
+  union
+  {
+    const char* static_message;
+    char* heap_message;
+    char inline_message[kInlineMessage];
+    Deferred deferred;
+  };
 };  // class ErrorCode
 
+// Stack of `ErrorCode`s, most recent on top, kept as a refcounted chain of
+// immutable nodes. Copies share the chain, pushing a code adds one node on
+// top and popping only moves this stack's head, so an error handed down a
+// `Then` chain, or given more context on the way, never copies the codes
+// underneath it.
+class ErrorStack
+{
+ public:
+  ErrorStack() : head_(nullptr)
+  {
+  }
+
+  ErrorStack(const ErrorStack& other) : head_(other.head_)
+  {
+    Retain(head_);
+  }
+
+  ErrorStack(ErrorStack&& other) noexcept : head_(other.head_)
+  {
+    other.head_ = nullptr;
+  }
+
+  ErrorStack& operator=(const ErrorStack& other)
+  {
+    Retain(other.head_);
+    Release(head_);
+    head_ = other.head_;
+
+    return *this;
+  }
+
+  ErrorStack& operator=(ErrorStack&& other) noexcept
+  {
+    if (this != &other) {
+      Release(head_);
+      head_ = other.head_;
+      other.head_ = nullptr;
+    }
+
+    return *this;
+  }
+
+  ~ErrorStack()
+  {
+    Release(head_);
+  }
+
+  bool empty() const
+  {
+    return head_ == nullptr;
+  }
+
+  size_t size() const
+  {
+    return head_ ? head_->depth : 0;
+  }
+
+  const ErrorCode& top() const
+  {
+    assert(head_);
+    return head_->code;
+  }
+
+  // Bottom (oldest) first. Walks down from the top, so prefer `top()`.
+  const ErrorCode& operator[](size_t i) const
+  {
+    assert(i < size());
+    const Node* node = head_;
+    for (size_t n = size() - 1; n > i; n--) {
+      node = node->next;
+    }
+
+    return node->code;
+  }
+
+  template <class... Args>
+  void emplace(Args&&... args)
+  {
+    head_ = new Node(head_, std::forward<Args>(args)...);
+  }
+
+  void push(const ErrorCode& code)
+  {
+    emplace(code);
+  }
+
+  void push(ErrorCode&& code)
+  {
+    emplace(std::move(code));
+  }
+
+  void pop()
+  {
+    assert(head_);
+    Node* top = head_;
+    head_ = top->next;
+    Retain(head_);
+    Release(top);
+  }
+
+  void clear()
+  {
+    Release(head_);
+    head_ = nullptr;
+  }
+
+  // Replaces the bottom of this stack with `base`: this stack's codes end up
+  // on top of `base`'s.
+  void Rebase(const ErrorStack& base)
+  {
+    ErrorStack stack(base);
+    PushOnto(head_, stack);
+    *this = std::move(stack);
+  }
+
+ private:
+  struct Node
+  {
+    template <class... Args>
+    explicit Node(Node* below, Args&&... args)
+        : code(std::forward<Args>(args)...),
+          next(below),
+          depth(below ? below->depth + 1 : 1),
+          refs(1)
+    {
+    }
+
+    static void* operator new(size_t size)
+    {
+      return AllocateBlock(size);
+    }
+
+    static void operator delete(void* p, size_t size)
+    {
+      DeallocateBlock(p, size);
+    }
+
+    const ErrorCode code;
+    // Owns one reference.
+    Node* const next;
+    const uint32_t depth;
+    std::atomic<uint32_t> refs;
+  };
+
+  static void Retain(Node* node)
+  {
+    if (node) {
+      node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Frees the run of nodes only this reference kept alive, iteratively so
+  // deep stacks do not recurse.
+  static void Release(Node* node)
+  {
+    while (node && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  static void PushOnto(const Node* node, ErrorStack& stack)
+  {
+    if (node) {
+      PushOnto(node->next, stack);
+      stack.push(node->code);
+    }
+  }
+
+  Node* head_;
+};  // class ErrorStack
+
 struct Error
 {
-  using ErrorStack = std::stack<ErrorCode>;
+  using ErrorStack = dien::ErrorStack;
 
   ErrorStack error_stack;
 
   Error(int code, std::string&& msg)
   {
-    ErrorStack new_stack;
-
-    error_stack.swap(new_stack);
-    error_stack.emplace(ErrorCode(code, std::forward<std::string>(msg)));
+    error_stack.emplace(code, msg);
   }
 
   Error(ErrorCode&& error_code)
@@ -97,29 +655,28 @@ struct Error
 
   Error(const ErrorCode& errorCode)
   {
-    error_stack.emplace(ErrorCode(errorCode));
+    error_stack.emplace(errorCode);
   }
 
+  // Puts `error`'s codes underneath ours. `error` is shared, not copied;
+  // only our own codes are re-linked on top of it.
   Error& Stack(const Error& error)
   {
-    ErrorStack temp;
-    while (!error_stack.empty()) {
-      temp.emplace(error_stack.top());
-      error_stack.pop();
-    }
-
-    error_stack = error.error_stack;
-    while (!temp.empty()) {
-      error_stack.emplace(temp.top());
-      temp.pop();
-    }
+    error_stack.Rebase(error.error_stack);
 
     return *this;
   }
 
   Error& Stack(const ErrorCode& errorCode)
   {
-    error_stack.emplace(ErrorCode(errorCode));
+    error_stack.push(errorCode);
+
+    return *this;
+  }
+
+  Error& Stack(ErrorCode&& errorCode)
+  {
+    error_stack.push(std::move(errorCode));
 
     return *this;
   }
@@ -131,20 +688,21 @@ struct Error
 
   void Clear()
   {
-    while (!error_stack.empty()) {
-      error_stack.pop();
-    }
+    error_stack.clear();
   }
 
-  &operator ErrorStack() &
+  operator ErrorStack&() &
   {
     return error_stack;
   }
 
-  &operator const ErrorStack() const &
+  operator const ErrorStack&() const &
   {
     return error_stack;
   }
 };  // class Error
 
+static_assert(sizeof(Error) == sizeof(void*),
+              "Error should be a single pointer");
+
 }  // namespace dien
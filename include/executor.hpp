@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ *  File:   executor.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `Executor` interface for running continuations off the
+ *              thread that fulfils a `Promise`.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include "inline_function.hpp"
+
+namespace dien
+{
+
+typedef InlineFunction<void()> Func;
+
+class Executor
+{
+ public:
+  virtual ~Executor()
+  {
+  }
+
+  // Schedules `func` to run. Must be safe to call from any thread.
+  virtual void Add(Func func) = 0;
+};  // class Executor
+
+// Runs every function on the calling thread, immediately.
+class InlineExecutor : public Executor
+{
+ public:
+  static InlineExecutor& Instance()
+  {
+    static InlineExecutor instance;
+    return instance;
+  }
+
+  void Add(Func func) override
+  {
+    func();
+  }
+};  // class InlineExecutor
+
+}  // namespace dien
@@ -11,8 +11,11 @@
 
 #include <chrono>
 
+#include "executor.hpp"
+#include "option.hpp"
 #include "promise.hpp"
 #include "shared_data.hpp"
+#include "timer_wheel.hpp"
 
 #include "future_inc.hpp"
 
@@ -74,19 +77,24 @@ class Future
 
   Future(FailedFuture);
 
+  // A future born ready with `t`; it holds the result inline.
+  explicit Future(Try<T> &&t) : shared_(nullptr), ready_(std::move(t))
+  {
+  }
+
   ~Future();
 
   template <class T2 = T>
   typename std::enable_if<!std::is_same<T2, void>::value, T>::type &Value()
   {
-    return shared_->Get();
+    return ready_ ? ready_->Value() : shared_->Get();
   }
 
   template <class T2 = T>
   typename std::enable_if<!std::is_same<T2, void>::value, const T>::type &
       Value() const
   {
-    return shared_->Get();
+    return ready_ ? ready_->Value() : shared_->Get();
   }
 
   bool IsReady() const;
@@ -104,16 +112,53 @@ class Future
     return Value();
   }
 
+  // Asks the producer to stop: runs the interrupt handler of the promise
+  // behind this future and, through `Then`, of the promises it was chained
+  // from (see `Promise::SetInterruptHandler`). Does not fulfil the future;
+  // a no-op once it is ready.
+  void Cancel();
+  void Cancel(Error error);
+
+  // Blocks the calling thread until the future is ready.
+  void Wait() const;
+
+  // Blocks until the future is ready or `timeout` elapses. Returns whether
+  // the future is ready.
+  template <class Rep, class Period>
+  bool Wait(const std::chrono::duration<Rep, Period> &timeout) const;
+
+  // Waits up to `timeout` and returns a copy of the result, or a `kTimedOut`
+  // error if the future is still not ready.
+  template <class Rep, class Period>
+  Try<T> Get(const std::chrono::duration<Rep, Period> &timeout);
+
+  // Returns a future that completes with this future's result, or with
+  // `error` if that has not arrived within `timeout`. The timer runs on
+  // `TimerWheel::Instance()` and is cancelled if the result wins the race;
+  // if it fires, `error` also interrupts this future (see `Cancel`), as
+  // does cancelling the returned one.
+  template <class Rep, class Period>
+  Future<T> Within(const std::chrono::duration<Rep, Period> &timeout,
+                   Error error)
+  {
+    return WithinImplementation(
+        timeout, [e = std::move(error)]() mutable { return std::move(e); });
+  }
+
+  // As above with a `kTimedOut` error, which is only built if the timer wins.
+  template <class Rep, class Period>
+  Future<T> Within(const std::chrono::duration<Rep, Period> &timeout)
+  {
+    return WithinImplementation(timeout, []() {
+      return Error(ErrorCode(kTimedOut));
+    });
+  }
+
 #if 0
   // TODO (jojy): Implement
   Try<T>& getTry();
 
   Optional<Try<T>> Poll();
-
-
-  T Get(Seconds dur);
-
-  T Get(MilliSeconds dur);
 #endif
 
   // TODO(jojy): private?
@@ -127,6 +172,18 @@ class Future
     return ThenImplementation<F, R>(std::forward<F>(func), Arguments());
   }
 
+  // Runs the continuation attached to this future on `executor` instead of
+  // inline on the thread that fulfils (or attaches to) it. Continuations
+  // chained further down run wherever their input is produced, which is
+  // `executor`'s thread unless they have their own `Via`.
+  Future<T> &Via(Executor *executor);
+
+  template <typename F, typename R = callable_result<T, F>>
+  typename R::Return Then(Executor *executor, F &&func)
+  {
+    return Via(executor).Then(std::forward<F>(func));
+  }
+
   template <typename R, typename Caller, typename... Args>
   Future<typename is_future<R>::Inner> Then(R (Caller::*func)(Args...),
                                             Caller *instance);
@@ -148,10 +205,19 @@ class Future
   // shared core state object
   SharedDataPtr shared_;
 
+  // The result of a future born ready (from a value, an error or a `Then` on
+  // another ready future), in which case `shared_` is null: such futures
+  // never allocate and their continuations run as they are attached.
+  Option<Try<T>> ready_;
+
   explicit Future(SharedDataPtr obj) : shared_(obj)
   {
   }
 
+  // Moves an inline result into a SharedData, for the paths (`Via`) that
+  // need one.
+  void Share();
+
   // Variant: returns a value
   // e.g. f.Then([](Try<T> t){ return t.value(); });
   template <typename F, typename R, bool isTry, typename... Args>
@@ -167,8 +233,18 @@ class Future
   template <typename F, typename R, typename... Args>
   typename std::enable_if<!R::ReturnsFuture::value, typename R::Return>::type
       OnErrorImplementation(F &&func, on_error_arg_result<F, Args...>);
+
+  // `make_error` is called on the timer thread if the timeout fires first.
+  template <class Rep, class Period, class E>
+  Future<T> WithinImplementation(
+      const std::chrono::duration<Rep, Period> &timeout, E &&make_error);
 };  // class Future
 
+// Returns a future that completes on the timer thread once `duration` has
+// elapsed.
+template <class Rep, class Period>
+Future<void> Sleep(const std::chrono::duration<Rep, Period> &duration);
+
 }  // namespace dien
 
 #include "future_impl.hpp"
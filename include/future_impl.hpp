@@ -8,15 +8,16 @@
 #pragma once
 
 #include <cassert>
+#include <atomic>
 #include <chrono>
+#include <memory>
 #include <thread>
 
-#include "option.hpp"
-
 namespace dien
 {
 template <class T>
-Future<T>::Future(Future<T>&& other) noexcept : shared_(other.shared_)
+Future<T>::Future(Future<T>&& other) noexcept
+    : shared_(other.shared_), ready_(std::move(other.ready_))
 {
   other.shared_ = nullptr;
 }
@@ -25,20 +26,21 @@ template <class T>
 Future<T>& Future<T>::operator=(Future<T>&& other) noexcept
 {
   std::swap(shared_, other.shared_);
+  std::swap(ready_, other.ready_);
   return *this;
 }
 
 template <class T>
 template <class T2, typename>
 Future<T>::Future(T2&& val)
-    : shared_(new SharedData<T>(Try<T>(std::forward<T2>(val))))
+    : shared_(nullptr), ready_(Try<T>(std::forward<T2>(val)))
 {
 }
 
 template <class T>
 template <typename T2>
 Future<T>::Future(typename std::enable_if<std::is_same<void, T2>::value>::type*)
-    : shared_(new SharedData<T>(Try<T>(T())))
+    : shared_(nullptr), ready_(Try<T>())
 {
 }
 
@@ -46,15 +48,14 @@ template <class T>
 template <typename V>
 Future<T>::Future(
     typename std::enable_if<std::is_same<void, V>::value>::type val)
-    : shared_(new SharedData<void>(Try<void>()))
+    : shared_(nullptr), ready_(Try<void>())
 {
 }
 
 template <class T>
 Future<T>::Future(FailedFuture f)
-    : shared_(new SharedData<T>())
+    : shared_(nullptr), ready_(Try<T>(std::move(f.error)))
 {
-  shared_->SetResult(Try<T>(f.error));
 }
 
 template <class T>
@@ -66,31 +67,207 @@ Future<T>::~Future()
 template <class T>
 void Future<T>::Detach()
 {
+  ready_.Clear();
+
   if (shared_) {
     shared_->DetachFuture();
     shared_ = nullptr;
   }
 }
 
+template <class T>
+void Future<T>::Share()
+{
+  if (ready_) {
+    shared_ = new SharedData<T>(std::move(ready_.Value()));
+    ready_.Clear();
+  }
+}
+
 template <class T>
 template <class F>
 void Future<T>::SetCallback_(F&& func)
 {
-  assert(shared_);
+  if (ready_) {
+    Try<T> t = std::move(ready_.Value());
+    ready_.Clear();
+    func(std::move(t));
+    return;
+  }
+
+  CHECK(shared_) << "Future used after it was consumed";
 
   shared_->SetCallback(std::forward<F>(func));
 }
 
+template <class T>
+Future<T>& Future<T>::Via(Executor* executor)
+{
+  Share();
+
+  assert(shared_);
+
+  shared_->SetExecutor(executor);
+  return *this;
+}
+
+template <class T>
+bool Future<T>::IsReady() const
+{
+  return ready_ || (shared_ && shared_->Ready());
+}
+
 template <class T>
 bool Future<T>::HasValue() const
 {
-  return shared_->Ready();
+  return ready_ || (shared_ && shared_->Ready());
+}
+
+template <class T>
+void Future<T>::Cancel()
+{
+  Cancel(Error(ErrorCode(kCancelled)));
+}
+
+template <class T>
+void Future<T>::Cancel(Error error)
+{
+  if (shared_) {
+    shared_->Interrupt(error);
+  }
+}
+
+template <class T>
+void Future<T>::Wait() const
+{
+  if (ready_) {
+    return;
+  }
+
+  assert(shared_);
+
+  shared_->WaitUntil(Deadline::max());
+}
+
+template <class T>
+template <class Rep, class Period>
+bool Future<T>::Wait(const std::chrono::duration<Rep, Period>& timeout) const
+{
+  if (ready_) {
+    return true;
+  }
+
+  assert(shared_);
+
+  return shared_->WaitUntil(
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+}
+
+template <class T>
+template <class Rep, class Period>
+Try<T> Future<T>::Get(const std::chrono::duration<Rep, Period>& timeout)
+{
+  if (!Wait(timeout)) {
+    return Try<T>(Error(ErrorCode(kTimedOut)));
+  }
+
+  return ready_ ? ready_.Value() : shared_->GetTry();
+}
+
+template <class T>
+template <class Rep, class Period, class E>
+Future<T> Future<T>::WithinImplementation(
+    const std::chrono::duration<Rep, Period>& timeout, E&& make_error)
+{
+  // Already fulfilled: nothing to race against.
+  if (ready_) {
+    Try<T> t = std::move(ready_.Value());
+    ready_.Clear();
+    return Future<T>(std::move(t));
+  }
+
+  CHECK(shared_) << "Future used after it was consumed";
+
+  // Shared by the timer and the continuation; whichever flips `done` first
+  // fulfils the promise.
+  struct Context
+  {
+    explicit Context(E&& e) : done(false), make_error(std::forward<E>(e))
+    {
+    }
+
+    std::atomic<bool> done;
+    Promise<T> promise;
+    typename std::decay<E>::type make_error;
+    Timer timer;
+  };
+
+  // The timer's hold on this future's state, so that a timeout can still
+  // interrupt the producer after the consumer has let go. Dropped with the
+  // timer function: once it has run, or been cancelled.
+  struct Upstream
+  {
+    explicit Upstream(SharedData<T>* s) : shared(s)
+    {
+      shared->AttachOne();
+    }
+
+    Upstream(Upstream&& other) noexcept : shared(other.shared)
+    {
+      other.shared = nullptr;
+    }
+
+    ~Upstream()
+    {
+      if (shared) {
+        shared->DetachOne();
+      }
+    }
+
+    SharedData<T>* shared;
+  };
+
+  auto context = std::make_shared<Context>(std::forward<E>(make_error));
+  Future<T> f = context->promise.GetFuture();
+  f.shared_->InitForwardInterrupts(shared_->GetInterruptSlot());
+
+  context->timer = TimerWheel::Instance().Add(
+      timeout, [context, upstream = Upstream(shared_)]() {
+        if (!context->done.exchange(true)) {
+          Error error = context->make_error();
+          upstream.shared->Interrupt(error);
+          context->promise.SetError(std::move(error));
+        }
+      });
+
+  SetCallback_([context](Try<T>&& t) {
+    if (!context->done.exchange(true)) {
+      context->timer.Cancel();
+      context->promise.SetTry(std::move(t));
+    }
+  });
+
+  return f;
+}
+
+template <class Rep, class Period>
+Future<void> Sleep(const std::chrono::duration<Rep, Period>& duration)
+{
+  Promise<void> p;
+  Future<void> f = p.GetFuture();
+
+  TimerWheel::Instance().Add(duration, [pm = std::move(p)]() mutable {
+    pm.SetWith([]() {});
+  });
+
+  return f;
 }
 
 template <class T>
 bool Future<T>::HasError() const
 {
-  return shared_->HasError();
+  return ready_ ? ready_->HasError() : (shared_ && shared_->HasError());
 }
 
 // Variant: returns a value
@@ -103,26 +280,34 @@ typename std::enable_if<!R::ReturnsFuture::value, typename R::Return>::type
   static_assert(sizeof...(Args) <= 1, "Then must take zero/one argument");
   typedef typename R::ReturnsFuture::Inner B;
 
-  assert(shared_);
+  // Already fulfilled: run the continuation now, into another ready future.
+  if (ready_) {
+    Try<T> t = std::move(ready_.Value());
+    ready_.Clear();
+    if (!isTry && t.HasError()) {
+      return Future<B>(Try<B>(std::move(t.GetError())));
+    }
 
-  std::shared_ptr<Promise<B>> p = std::make_shared<Promise<B>>();
+    return Future<B>(
+        MakeTryWith([&]() { return func(t.template Get<isTry, Args>()...); }));
+  }
+
+  CHECK(shared_) << "Future used after it was consumed";
 
-  // grab the Future now before we lose our handle on the Promise
-  auto f = p->GetFuture();
+  Promise<B> p;
 
-  std::function<void(Try<T> && )> fn =
-      std::bind([p, func](Try<T>&& t) mutable {
-                  if (!isTry && t.HasError()) {
-                    p->SetError(std::move(t.GetError()));
-                  } else {
-                    p->SetWith([&]() {
-                      return func(t.template Get<isTry, Args>()...);
-                    });
-                  }
-                },
-                std::placeholders::_1);
+  // grab the Future now, the continuation takes ownership of the Promise
+  auto f = p.GetFuture();
+  f.shared_->InitForwardInterrupts(shared_->GetInterruptSlot());
 
-  SetCallback_(fn);
+  SetCallback_([ pm = std::move(p), funcm = std::forward<F>(func) ](
+      Try<T> && t) mutable {
+    if (!isTry && t.HasError()) {
+      pm.SetError(std::move(t.GetError()));
+    } else {
+      pm.SetWith([&]() { return funcm(t.template Get<isTry, Args>()...); });
+    }
+  });
 
   return f;
 }
@@ -137,31 +322,41 @@ typename std::enable_if<R::ReturnsFuture::value, typename R::Return>::type
   static_assert(sizeof...(Args) <= 1, "Then must take zero/one argument");
   typedef typename R::ReturnsFuture::Inner B;
 
-  assert(shared_);
+  // Already fulfilled: the continuation's own future is the result.
+  if (ready_) {
+    Try<T> t = std::move(ready_.Value());
+    ready_.Clear();
+    if (!isTry && t.HasError()) {
+      return Future<B>(Try<B>(std::move(t.GetError())));
+    }
+
+    return func(t.template Get<isTry, Args>()...);
+  }
 
-  std::shared_ptr<Promise<B>> p = std::make_shared<Promise<B>>();
-
-  // grab the Future
-  auto f = p->GetFuture();
-
-  SetCallback_(
-      [ funcm = std::forward<F>(func), pm = p ](Try<T> && t) mutable {
-                                                 if (!isTry && t.HasError()) {
-                                                   pm->SetError(
-                                                       std::move(t.GetError()));
-                                                 } else {
-                                                   auto f2 =
-                                                       funcm(t.template Get<
-                                                           isTry, Args>()...);
-                                                   // that didn't throw, now we
-                                                   // can steal p
-                                                   f2.SetCallback_(
-                                                       [p = pm](Try<B> && b) mutable {
-                                                         p->SetTry(
-                                                             std::move(b));
-                                                       });
-                                                 }
-                                               });
+  CHECK(shared_) << "Future used after it was consumed";
+
+  Promise<B> p;
+
+  // grab the Future, the continuation takes ownership of the Promise
+  auto f = p.GetFuture();
+  f.shared_->InitForwardInterrupts(shared_->GetInterruptSlot());
+
+  SetCallback_([ pm = std::move(p), funcm = std::forward<F>(func) ](
+      Try<T> && t) mutable {
+    if (!isTry && t.HasError()) {
+      pm.SetError(std::move(t.GetError()));
+    } else {
+      auto f2 = funcm(t.template Get<isTry, Args>()...);
+      // From now on it is `f2` that is worth interrupting.
+      if (f2.shared_) {
+        pm.shared_->ForwardInterrupts(f2.shared_->GetInterruptSlot());
+      }
+      // that didn't throw, now we can hand the Promise on
+      f2.SetCallback_([p = std::move(pm)](Try<B> && b) mutable {
+        p.SetTry(std::move(b));
+      });
+    }
+  });
 
   return f;
 }
@@ -175,24 +370,24 @@ typename std::enable_if<!R::ReturnsFuture::value, typename R::Return>::type
   static_assert(sizeof...(Args) <= 1, "Then must take zero/one argument");
   typedef typename R::ReturnsFuture::Inner B;
 
-  assert(shared_);
-
-  std::shared_ptr<Promise<B>> p = std::make_shared<Promise<B>>();
+  CHECK(shared_ || ready_) << "Future used after it was consumed";
 
-  // grab the Future now before we lose our handle on the Promise
-  auto f = p->GetFuture();
+  Promise<B> p;
 
-  std::function<void(Try<T> && )> fn =
-      std::bind([p, func](Try<T>&& t) mutable {
-                  if (t.HasError()) {
-                    t.template WithError([&](Error&& e) {
-                      p->SetWith([&] { return func(std::move(e)); });
-                    });
-                  }
-                },
-                std::placeholders::_1);
+  // grab the Future now, the continuation takes ownership of the Promise
+  auto f = p.GetFuture();
+  if (shared_) {
+    f.shared_->InitForwardInterrupts(shared_->GetInterruptSlot());
+  }
 
-  SetCallback_(fn);
+  SetCallback_([ pm = std::move(p), funcm = std::forward<F>(func) ](
+      Try<T> && t) mutable {
+    if (t.HasError()) {
+      t.template WithError([&](Error&& e) {
+        pm.SetWith([&] { return funcm(std::move(e)); });
+      });
+    }
+  });
 
   return f;
 }
@@ -0,0 +1,37 @@
+/******************************************************************************
+ *
+ *  File:   index_sequence.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Compile-time index packs, for expanding tuples and argument
+ *              packs element by element.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+
+namespace dien
+{
+
+namespace detail
+{
+
+template <size_t... Is>
+struct IndexSequence
+{};
+
+template <size_t N, size_t... Is>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Is...>
+{};
+
+template <size_t... Is>
+struct MakeIndexSequence<0, Is...>
+{
+  typedef IndexSequence<Is...> type;
+};
+
+}  // namespace detail
+
+}  // namespace dien
@@ -0,0 +1,227 @@
+/******************************************************************************
+ *
+ *  File:   inline_function.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `InlineFunction`, a move-only type erased callable with
+ *              in-place storage. Callables that fit the storage never touch
+ *              the heap; bigger ones fall back to a heap allocation.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dien
+{
+
+// Sized so that a continuation capturing a Promise plus a small user functor
+// stays inline.
+static const size_t kInlineFunctionCapacity = 48;
+
+template <typename Signature, size_t Capacity = kInlineFunctionCapacity>
+class InlineFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity>
+{
+ public:
+  InlineFunction() noexcept : ops_(nullptr)
+  {
+  }
+
+  InlineFunction(std::nullptr_t) noexcept : ops_(nullptr)
+  {
+  }
+
+  template <class F, typename = typename std::enable_if<
+                         !std::is_same<typename std::decay<F>::type,
+                                       InlineFunction>::value>::type>
+  InlineFunction(F&& func) : ops_(nullptr)
+  {
+    Construct(std::forward<F>(func));
+  }
+
+  InlineFunction(InlineFunction&& other) noexcept : ops_(other.ops_)
+  {
+    if (ops_) {
+      ops_->move(&storage_, &other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  InlineFunction& operator=(InlineFunction&& other) noexcept
+  {
+    if (this != &other) {
+      Clear();
+      if (other.ops_) {
+        other.ops_->move(&storage_, &other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+
+    return *this;
+  }
+
+  InlineFunction& operator=(std::nullptr_t) noexcept
+  {
+    Clear();
+    return *this;
+  }
+
+  template <class F, typename = typename std::enable_if<
+                         !std::is_same<typename std::decay<F>::type,
+                                       InlineFunction>::value &&
+                         !std::is_same<typename std::decay<F>::type,
+                                       std::nullptr_t>::value>::type>
+  InlineFunction& operator=(F&& func)
+  {
+    Clear();
+    Construct(std::forward<F>(func));
+    return *this;
+  }
+
+  InlineFunction(const InlineFunction&) = delete;
+  InlineFunction& operator=(const InlineFunction&) = delete;
+
+  ~InlineFunction()
+  {
+    Clear();
+  }
+
+  R operator()(Args... args)
+  {
+    assert(ops_);
+    return ops_->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const
+  {
+    return ops_ != nullptr;
+  }
+
+  // True if the callable lives in the in-place storage.
+  bool IsInline() const
+  {
+    return ops_ && ops_->is_inline;
+  }
+
+  void Clear()
+  {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  typedef typename std::aligned_storage<Capacity, alignof(void*)>::type Storage;
+
+  struct Ops
+  {
+    R (*invoke)(void* storage, Args&&... args);
+    void (*move)(void* to, void* from);
+    void (*destroy)(void* storage);
+    bool is_inline;
+  };
+
+  template <class F>
+  struct Fits
+      : std::integral_constant<bool,
+                               sizeof(F) <= Capacity &&
+                                   alignof(F) <= alignof(Storage) &&
+                                   std::is_nothrow_move_constructible<F>::value>
+  {};
+
+  template <class F>
+  struct InlineOps
+  {
+    static R Invoke(void* storage, Args&&... args)
+    {
+      return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+    }
+
+    static void Move(void* to, void* from)
+    {
+      new (to) F(std::move(*static_cast<F*>(from)));
+      static_cast<F*>(from)->~F();
+    }
+
+    static void Destroy(void* storage)
+    {
+      static_cast<F*>(storage)->~F();
+    }
+
+    static const Ops ops;
+  };
+
+  template <class F>
+  struct HeapOps
+  {
+    static F*& Get(void* storage)
+    {
+      return *static_cast<F**>(storage);
+    }
+
+    static R Invoke(void* storage, Args&&... args)
+    {
+      return (*Get(storage))(std::forward<Args>(args)...);
+    }
+
+    static void Move(void* to, void* from)
+    {
+      new (to) F*(Get(from));
+    }
+
+    static void Destroy(void* storage)
+    {
+      delete Get(storage);
+    }
+
+    static const Ops ops;
+  };
+
+  template <class F>
+  typename std::enable_if<Fits<typename std::decay<F>::type>::value>::type
+      Construct(F&& func)
+  {
+    typedef typename std::decay<F>::type Functor;
+
+    new (&storage_) Functor(std::forward<F>(func));
+    ops_ = &InlineOps<Functor>::ops;
+  }
+
+  template <class F>
+  typename std::enable_if<!Fits<typename std::decay<F>::type>::value>::type
+      Construct(F&& func)
+  {
+    typedef typename std::decay<F>::type Functor;
+
+    new (&storage_) Functor*(new Functor(std::forward<F>(func)));
+    ops_ = &HeapOps<Functor>::ops;
+  }
+
+  const Ops* ops_;
+  Storage storage_;
+};  // class InlineFunction
+
+template <typename R, typename... Args, size_t Capacity>
+template <class F>
+const typename InlineFunction<R(Args...), Capacity>::Ops
+    InlineFunction<R(Args...), Capacity>::InlineOps<F>::ops = {
+        &InlineOps<F>::Invoke, &InlineOps<F>::Move, &InlineOps<F>::Destroy,
+        true};
+
+template <typename R, typename... Args, size_t Capacity>
+template <class F>
+const typename InlineFunction<R(Args...), Capacity>::Ops
+    InlineFunction<R(Args...), Capacity>::HeapOps<F>::ops = {
+        &HeapOps<F>::Invoke, &HeapOps<F>::Move, &HeapOps<F>::Destroy, false};
+
+}  // namespace dien
@@ -0,0 +1,284 @@
+/******************************************************************************
+ *
+ *  File:   interrupt.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `InterruptSlot`, the cancellation channel from a `Future`
+ *              back to its `Promise`.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include "allocator.hpp"
+#include "error.hpp"
+#include "inline_function.hpp"
+
+namespace dien
+{
+
+typedef InlineFunction<void(const Error&)> InterruptHandler;
+
+namespace detail
+{
+
+// Either the producer's handler or the error raised before it was set.
+struct InterruptNode
+{
+  explicit InterruptNode(InterruptHandler&& h)
+      : handler(std::move(h)), error(Error::ErrorStack())
+  {
+  }
+
+  explicit InterruptNode(const Error& e) : error(e)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  InterruptHandler handler;
+  Error error;
+};
+
+// One word per SharedData, written by the producer (`SetHandler`,
+// `SetForward`, `Close`) and the consumer (`Raise`). Its value is one of
+//
+//   0                      nothing yet
+//   InterruptNode* | 1     the producer's handler
+//   InterruptSlot* | 2     raises are passed on to another slot: the state
+//                          a `Then` link waits on
+//   InterruptNode* | 3     raised before anyone listened; holds the error
+//   kBusy                  a `Raise` is passing on through the forward
+//   kClosed                the handler was taken, or the result is in
+//
+// A `Raise` holds a forwarding word (kBusy) while it follows it, and `Close`
+// waits for that. It keeps the target alive: the target is the input of the
+// link that will fulfil us, and it cannot be freed before that link has
+// fulfilled (and so closed) us.
+class InterruptSlot
+{
+ public:
+  InterruptSlot() : word_(0)
+  {
+  }
+
+  ~InterruptSlot()
+  {
+    Free(word_.load(std::memory_order_acquire));
+  }
+
+  InterruptSlot(const InterruptSlot&) = delete;
+  InterruptSlot& operator=(const InterruptSlot&) = delete;
+
+  // Producer: `handler` runs once, on the first `Raise`, or right here if
+  // that came first. Replaces an earlier handler; a no-op once closed.
+  void SetHandler(InterruptHandler&& handler)
+  {
+    InterruptNode* node = new InterruptNode(std::move(handler));
+    Install(reinterpret_cast<uintptr_t>(node) | kHandler);
+  }
+
+  // Producer: from now on raises go to `target`.
+  void SetForward(InterruptSlot* target)
+  {
+    Install(reinterpret_cast<uintptr_t>(target) | kForward);
+  }
+
+  // As above, on a slot no other thread can reach yet.
+  void InitForward(InterruptSlot* target)
+  {
+    assert(word_.load(std::memory_order_relaxed) == 0);
+    word_.store(reinterpret_cast<uintptr_t>(target) | kForward,
+                std::memory_order_relaxed);
+  }
+
+  // Consumer: runs the handler, through any forwards, or records `error`
+  // for a handler still to come. Only the first raise counts.
+  void Raise(const Error& error)
+  {
+    InterruptNode* node = Claim(error);
+    if (node) {
+      node->handler(error);
+      delete node;
+    }
+  }
+
+  // Producer, before publishing the result: no handler runs after this
+  // returns, and nothing is forwarded any more.
+  void Close()
+  {
+    uintptr_t word = word_.load(std::memory_order_acquire);
+    for (;;) {
+      if (word == kClosed) {
+        return;
+      }
+
+      if (word == kBusy) {
+        std::this_thread::yield();
+        word = word_.load(std::memory_order_acquire);
+        continue;
+      }
+
+      if (word_.compare_exchange_weak(word, kClosed)) {
+        Free(word);
+        return;
+      }
+    }
+  }
+
+  // Whether nothing was ever installed or raised here, so that `Close`
+  // would have nothing to take.
+  bool Empty() const
+  {
+    return word_.load(std::memory_order_acquire) == 0;
+  }
+
+  // Whether nothing but forwards (or nothing at all) was installed, so
+  // that skipping `Close` leaks nothing and runs no handler late.
+  bool Idle() const
+  {
+    uintptr_t word = word_.load(std::memory_order_relaxed);
+    return word == 0 || Tag(word) == kForward;
+  }
+
+ private:
+  static const uintptr_t kHandler = 1;
+  static const uintptr_t kForward = 2;
+  static const uintptr_t kRaised = 3;
+  static const uintptr_t kTagMask = 3;
+
+  static const uintptr_t kBusy = 4;
+  static const uintptr_t kClosed = 8;
+
+  static_assert(alignof(InterruptNode) > kTagMask,
+                "interrupt nodes must leave room for the tag");
+
+  static uintptr_t Tag(uintptr_t word)
+  {
+    return word & kTagMask;
+  }
+
+  static InterruptNode* Node(uintptr_t word)
+  {
+    return reinterpret_cast<InterruptNode*>(word & ~kTagMask);
+  }
+
+  static InterruptSlot* Target(uintptr_t word)
+  {
+    return reinterpret_cast<InterruptSlot*>(word & ~kTagMask);
+  }
+
+  static void Free(uintptr_t word)
+  {
+    if (Tag(word) == kHandler || Tag(word) == kRaised) {
+      delete Node(word);
+    }
+  }
+
+  // Takes the handler that should hear `error`, following forwards, or
+  // records the error where there is none yet. Each forward is held (kBusy)
+  // only while the slot it points at is claimed; the handler is run by
+  // `Raise` after every slot is let go, so it may fulfil the promise (and
+  // close these very slots) on this thread.
+  InterruptNode* Claim(const Error& error)
+  {
+    for (;;) {
+      uintptr_t word = word_.load(std::memory_order_acquire);
+      if (word == kBusy || word == kClosed || Tag(word) == kRaised) {
+        return nullptr;
+      }
+
+      if (word == 0) {
+        InterruptNode* node = new InterruptNode(error);
+        if (word_.compare_exchange_strong(
+                word, reinterpret_cast<uintptr_t>(node) | kRaised)) {
+          return nullptr;
+        }
+
+        delete node;
+        continue;
+      }
+
+      if (Tag(word) == kHandler) {
+        if (word_.compare_exchange_strong(word, kClosed)) {
+          return Node(word);
+        }
+
+        continue;
+      }
+
+      if (!word_.compare_exchange_strong(word, kBusy)) {
+        continue;
+      }
+
+      InterruptNode* handler = Target(word)->Claim(error);
+
+      // Remember the error: the link may forward us again, to the future its
+      // continuation returned.
+      word_.store(reinterpret_cast<uintptr_t>(new InterruptNode(error)) |
+                      kRaised,
+                  std::memory_order_release);
+      return handler;
+    }
+  }
+
+  // Installs a handler or a forward, or hands it a raise that came first.
+  void Install(uintptr_t installed)
+  {
+    uintptr_t word = word_.load(std::memory_order_acquire);
+    for (;;) {
+      if (word == kBusy) {
+        std::this_thread::yield();
+        word = word_.load(std::memory_order_acquire);
+        continue;
+      }
+
+      if (word == kClosed) {
+        Free(installed);
+        return;
+      }
+
+      // A forward target gets the raise but the error stays recorded; a
+      // handler consumes it.
+      if (Tag(word) == kRaised) {
+        if (Tag(installed) == kForward) {
+          Target(installed)->Raise(Node(word)->error);
+          return;
+        }
+
+        if (!word_.compare_exchange_weak(word, kClosed)) {
+          continue;
+        }
+
+        Node(installed)->handler(Node(word)->error);
+        Free(installed);
+        Free(word);
+        return;
+      }
+
+      if (word_.compare_exchange_weak(word, installed)) {
+        Free(word);
+        return;
+      }
+    }
+  }
+
+  std::atomic<uintptr_t> word_;
+};  // class InterruptSlot
+
+}  // namespace detail
+}  // namespace dien
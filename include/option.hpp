@@ -32,7 +32,7 @@ public:
     }
   }
 
-  Option(const Option&& other)
+  Option(Option&& other)
   {
     if (other.HasValue()) {
       Construct(std::move(other.Value()));
@@ -53,10 +53,10 @@ public:
     }
   }
 
-  void Assign(const Option&& oth)
+  void Assign(Option&& oth)
   {
     if (oth.HasValue()) {
-      Assign(oth.Value());
+      Assign(std::move(oth.Value()));
     } else {
       Clear();
     }
@@ -71,7 +71,7 @@ public:
     }
   }
 
-  void Assign(const T&& newVal)
+  void Assign(T&& newVal)
   {
     if (HasValue()) {
       storage_.value = std::move(newVal);
@@ -93,7 +93,7 @@ public:
     return *this;
   }
 
-  Option& operator=(const Option&& other)
+  Option& operator=(Option&& other)
   {
     Assign(std::move(other));
     return *this;
@@ -0,0 +1,426 @@
+/******************************************************************************
+ *
+ *  File:   parallel.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Data-parallel loops over an index range, each returning one
+ *              `Future`: `ParallelFor`, `ParallelMap` and `ParallelReduce`.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "allocator.hpp"
+#include "future.hpp"
+#include "shared_data.hpp"
+
+namespace dien
+{
+
+namespace detail
+{
+
+// Run a loop body step and report an error returned as a failed `Try`.
+// `ParallelCall` takes steps that return nothing or a `Try<void>`;
+// `ParallelStep` those that return a value or a `Try` of one, stored in
+// `out`.
+template <class F, class... Args>
+typename std::enable_if<std::is_void<ResultOf<F&, Args...>>::value,
+                        bool>::type
+    ParallelCall(Error*&, F& func, Args&&... args)
+{
+  func(std::forward<Args>(args)...);
+  return true;
+}
+
+template <class F, class... Args>
+typename std::enable_if<std::is_same<ResultOf<F&, Args...>, Try<void>>::value,
+                        bool>::type
+    ParallelCall(Error*& error, F& func, Args&&... args)
+{
+  Try<void> t = func(std::forward<Args>(args)...);
+  if (t.HasError()) {
+    error = new Error(std::move(t.GetError()));
+    return false;
+  }
+
+  return true;
+}
+
+template <class F, class Out, class... Args>
+typename std::enable_if<
+    !is_try<typename std::decay<ResultOf<F&, Args...>>::type>::value,
+    bool>::type
+    ParallelStep(Error*&, Out& out, F& func, Args&&... args)
+{
+  out = func(std::forward<Args>(args)...);
+  return true;
+}
+
+template <class F, class Out, class... Args>
+typename std::enable_if<
+    is_try<typename std::decay<ResultOf<F&, Args...>>::type>::value,
+    bool>::type
+    ParallelStep(Error*& error, Out& out, F& func, Args&&... args)
+{
+  auto t = func(std::forward<Args>(args)...);
+  if (t.HasError()) {
+    error = new Error(std::move(t.GetError()));
+    return false;
+  }
+
+  out = std::move(t).Value();
+  return true;
+}
+
+// The value type a step produces, looking through `Try`.
+template <class R>
+struct ParallelValue
+{
+  typedef R type;
+};
+
+template <class R>
+struct ParallelValue<Try<R>>
+{
+  typedef R type;
+};
+
+// One run of a parallel loop over [begin, end): `workers` tasks on the
+// executor claim chunks from a shared cursor until the range is used up.
+// Chunks shrink as the range does (guided scheduling), never below `grain`:
+// early claims are big, so claiming is cheap, and late ones small, so that
+// workers finish together. The body sees the claiming worker's index, for
+// per-worker state, and the last worker to finish fulfils the future with
+// `body.Finish()`, or with the first error a step returned; after an error
+// no more chunks are claimed.
+template <class R, class Body>
+class ParallelLoop
+{
+ public:
+  ParallelLoop(size_t begin, size_t end, size_t grain, size_t workers,
+               Body&& body)
+      : next_(begin),
+        end_(end),
+        grain_(std::max<size_t>(grain, 1)),
+        workers_(workers),
+        remaining_(workers),
+        error_(nullptr),
+        body_(std::move(body))
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  Future<R> Start(Executor& executor)
+  {
+    Future<R> f = promise_.GetFuture();
+
+    for (size_t worker = 0; worker < workers_; worker++) {
+      executor.Add([this, worker]() { Work(worker); });
+    }
+
+    return f;
+  }
+
+ private:
+  void Work(size_t worker)
+  {
+    size_t begin;
+    size_t end;
+    while (!error_.load(std::memory_order_relaxed) && Claim(begin, end)) {
+      Error* error = nullptr;
+      if (!body_.Run(worker, begin, end, error)) {
+        Error* expected = nullptr;
+        if (!error_.compare_exchange_strong(expected, error)) {
+          delete error;
+        }
+        break;
+      }
+    }
+
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+
+    Error* error = error_.load(std::memory_order_relaxed);
+    if (error) {
+      promise_.SetError(std::move(*error));
+      delete error;
+    } else {
+      Fulfil(promise_, body_.Finish());
+    }
+
+    delete this;
+  }
+
+  bool Claim(size_t& begin, size_t& end)
+  {
+    size_t current = next_.load(std::memory_order_relaxed);
+    for (;;) {
+      if (current >= end_) {
+        return false;
+      }
+
+      size_t left = end_ - current;
+      size_t take = std::min(left, std::max(grain_, left / (2 * workers_)));
+      if (next_.compare_exchange_weak(current, current + take,
+                                      std::memory_order_relaxed)) {
+        begin = current;
+        end = current + take;
+        return true;
+      }
+    }
+  }
+
+  std::atomic<size_t> next_;
+  const size_t end_;
+  const size_t grain_;
+  const size_t workers_;
+  std::atomic<size_t> remaining_;
+  std::atomic<Error*> error_;
+  Promise<R> promise_;
+  Body body_;
+};  // class ParallelLoop
+
+template <class F>
+struct ForBody
+{
+  bool Run(size_t, size_t begin, size_t end, Error*& error)
+  {
+    for (size_t i = begin; i < end; i++) {
+      if (!ParallelCall(error, func, i)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  Try<void> Finish()
+  {
+    return Try<void>();
+  }
+
+  F func;
+};
+
+// Where `MapBody` puts its results: a vector, except for `bool`, whose
+// vector packs elements into shared words that workers writing neighbouring
+// chunks would race on.
+template <class U>
+struct MapOutput
+{
+  explicit MapOutput(size_t n) : values(n)
+  {
+  }
+
+  U& operator[](size_t i)
+  {
+    return values[i];
+  }
+
+  std::vector<U> Take()
+  {
+    return std::move(values);
+  }
+
+  std::vector<U> values;
+};
+
+template <>
+struct MapOutput<bool>
+{
+  explicit MapOutput(size_t n) : values(new bool[n]()), size(n)
+  {
+  }
+
+  bool& operator[](size_t i)
+  {
+    return values[i];
+  }
+
+  std::vector<bool> Take()
+  {
+    return std::vector<bool>(values.get(), values.get() + size);
+  }
+
+  std::unique_ptr<bool[]> values;
+  size_t size;
+};
+
+template <class T, class U, class F>
+struct MapBody
+{
+  bool Run(size_t, size_t begin, size_t end, Error*& error)
+  {
+    for (size_t i = begin; i < end; i++) {
+      if (!ParallelStep(error, output[i], func, input[i])) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  Try<std::vector<U>> Finish()
+  {
+    return Try<std::vector<U>>(output.Take());
+  }
+
+  std::vector<T> input;
+  MapOutput<U> output;
+  F func;
+};
+
+// Keeps the workers' accumulators on separate cache lines.
+template <class V>
+struct ParallelPartial
+{
+  explicit ParallelPartial(const V& v) : value(v)
+  {
+  }
+
+  V value;
+  char pad[kCacheLineSize];
+};
+
+template <class V, class F, class C>
+struct ReduceBody
+{
+  bool Run(size_t worker, size_t begin, size_t end, Error*& error)
+  {
+    V& accumulator = partials[worker].value;
+    for (size_t i = begin; i < end; i++) {
+      if (!ParallelStep(error, accumulator, func, std::move(accumulator), i)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Pairwise, so each partial takes part in log2(workers) combines.
+  Try<V> Finish()
+  {
+    size_t count = partials.size();
+    for (size_t step = 1; step < count; step *= 2) {
+      for (size_t i = 0; i + step < count; i += 2 * step) {
+        partials[i].value = combine(std::move(partials[i].value),
+                                    std::move(partials[i + step].value));
+      }
+    }
+
+    return Try<V>(std::move(partials[0].value));
+  }
+
+  std::vector<ParallelPartial<V>> partials;
+  F func;
+  C combine;
+};
+
+// No more workers than there are chunks of `grain`.
+inline size_t ParallelWorkers(size_t threads, size_t count, size_t grain)
+{
+  size_t chunks = (count + std::max<size_t>(grain, 1) - 1) /
+                  std::max<size_t>(grain, 1);
+  return std::max<size_t>(1, std::min(threads, chunks));
+}
+
+}  // namespace detail
+
+// The loops below run on `executor`, which must have `NumThreads()` (the
+// shipped `ThreadPoolExecutor` and `WorkStealingExecutor` do), with one task
+// per thread. `grain` is the smallest chunk of indices a task takes at a
+// time: make it large enough that a chunk outweighs an atomic increment.
+// Steps report failure by returning a failed `Try`; the future then fails
+// with the first such error and the remaining chunks are skipped.
+
+// Calls `func(i)` for every i in [begin, end). `func` returns `void` or
+// `Try<void>`.
+template <class E, class F>
+Future<void> ParallelFor(E& executor, size_t begin, size_t end, size_t grain,
+                         F&& func)
+{
+  if (begin >= end) {
+    return Future<void>();
+  }
+
+  typedef detail::ForBody<typename std::decay<F>::type> Body;
+  size_t workers =
+      detail::ParallelWorkers(executor.NumThreads(), end - begin, grain);
+
+  return (new detail::ParallelLoop<void, Body>(
+              begin, end, grain, workers, Body{std::forward<F>(func)}))
+      ->Start(executor);
+}
+
+// `func(T&)` for every element of `input`, into a vector of the results in
+// the same order. `func` returns a `U` or a `Try<U>`; `U` must be default
+// constructible.
+template <class E, class T, class F,
+          class U = typename detail::ParallelValue<typename std::decay<
+              ResultOf<F&, T&>>::type>::type>
+Future<std::vector<U>> ParallelMap(E& executor, std::vector<T> input,
+                                   size_t grain, F&& func)
+{
+  if (input.empty()) {
+    return Future<std::vector<U>>(std::vector<U>());
+  }
+
+  typedef detail::MapBody<T, U, typename std::decay<F>::type> Body;
+  size_t count = input.size();
+  size_t workers = detail::ParallelWorkers(executor.NumThreads(), count, grain);
+
+  detail::MapOutput<U> output(count);
+  return (new detail::ParallelLoop<std::vector<U>, Body>(
+              0, count, grain, workers,
+              Body{std::move(input), std::move(output), std::forward<F>(func)}))
+      ->Start(executor);
+}
+
+// Folds [begin, end) with `func(V&& accumulator, size_t i)`, which returns
+// the new accumulator (a `V` or a `Try<V>`). Each worker folds the chunks it
+// claims into its own accumulator, starting from `identity`, and the
+// accumulators are then merged with `combine(V&&, V&&)`. Which indices a
+// worker gets is not fixed, so `combine` must be associative and
+// commutative, with `identity` neutral for it.
+template <class E, class V, class F, class C>
+Future<V> ParallelReduce(E& executor, size_t begin, size_t end, size_t grain,
+                         V identity, F&& func, C&& combine)
+{
+  if (begin >= end) {
+    return Future<V>(std::move(identity));
+  }
+
+  typedef detail::ReduceBody<V, typename std::decay<F>::type,
+                             typename std::decay<C>::type>
+      Body;
+  size_t workers =
+      detail::ParallelWorkers(executor.NumThreads(), end - begin, grain);
+
+  std::vector<detail::ParallelPartial<V>> partials(
+      workers, detail::ParallelPartial<V>(identity));
+  return (new detail::ParallelLoop<V, Body>(
+              begin, end, grain, workers,
+              Body{std::move(partials), std::forward<F>(func),
+                   std::forward<C>(combine)}))
+      ->Start(executor);
+}
+
+}  // namespace dien
@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ *  File:   park.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Thread parking primitives on a 32-bit atomic word. Uses futex
+ *              on Linux and a striped condition variable table elsewhere.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+namespace dien
+{
+
+typedef std::chrono::steady_clock::time_point Deadline;
+
+// Hint to the CPU that we are in a spin-wait loop.
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+#if defined(__linux__)
+
+namespace detail
+{
+
+inline long Futex(std::atomic<uint32_t>& word, int op, uint32_t value,
+                  const struct timespec* timeout)
+{
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex word must be a plain 32-bit integer");
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value,
+                 timeout, nullptr, 0);
+}
+
+}  // namespace detail
+
+// Blocks while `word == expected`. May return spuriously.
+inline void Park(std::atomic<uint32_t>& word, uint32_t expected)
+{
+  detail::Futex(word, FUTEX_WAIT_PRIVATE, expected, nullptr);
+}
+
+// Blocks while `word == expected` or until `deadline`. Returns false if the
+// deadline has passed. May return spuriously.
+inline bool ParkUntil(std::atomic<uint32_t>& word, uint32_t expected,
+                      Deadline deadline)
+{
+  auto now = std::chrono::steady_clock::now();
+  if (now >= deadline) {
+    return false;
+  }
+
+  auto nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now)
+          .count();
+  struct timespec timeout;
+  timeout.tv_sec = nanos / 1000000000;
+  timeout.tv_nsec = nanos % 1000000000;
+
+  detail::Futex(word, FUTEX_WAIT_PRIVATE, expected, &timeout);
+  return true;
+}
+
+inline void UnparkOne(std::atomic<uint32_t>& word)
+{
+  detail::Futex(word, FUTEX_WAKE_PRIVATE, 1, nullptr);
+}
+
+inline void UnparkAll(std::atomic<uint32_t>& word)
+{
+  detail::Futex(word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr);
+}
+
+#else
+
+namespace detail
+{
+
+struct ParkingStripe
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+inline ParkingStripe& Stripe(const void* address)
+{
+  static ParkingStripe stripes[64];
+  return stripes[(reinterpret_cast<uintptr_t>(address) >> 4) % 64];
+}
+
+}  // namespace detail
+
+inline void Park(std::atomic<uint32_t>& word, uint32_t expected)
+{
+  detail::ParkingStripe& stripe = detail::Stripe(&word);
+  std::unique_lock<std::mutex> lock(stripe.mutex);
+  if (word.load() == expected) {
+    stripe.cv.wait(lock);
+  }
+}
+
+inline bool ParkUntil(std::atomic<uint32_t>& word, uint32_t expected,
+                      Deadline deadline)
+{
+  detail::ParkingStripe& stripe = detail::Stripe(&word);
+  std::unique_lock<std::mutex> lock(stripe.mutex);
+  if (word.load() == expected) {
+    return stripe.cv.wait_until(lock, deadline) == std::cv_status::no_timeout;
+  }
+
+  return true;
+}
+
+// Stripes are shared between words, so every waiter on the stripe is woken.
+inline void UnparkOne(std::atomic<uint32_t>& word)
+{
+  detail::ParkingStripe& stripe = detail::Stripe(&word);
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+  stripe.cv.notify_all();
+}
+
+inline void UnparkAll(std::atomic<uint32_t>& word)
+{
+  UnparkOne(word);
+}
+
+#endif
+
+}  // namespace dien
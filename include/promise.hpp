@@ -12,6 +12,8 @@
 #include <functional>
 
 #include "error.hpp"
+#include "executor.hpp"
+#include "span.hpp"
 #include "try.hpp"
 
 namespace dien
@@ -20,6 +22,12 @@ namespace dien
 template <class T>
 class Future;
 
+namespace detail
+{
+template <class T>
+class PromiseBatch;
+}  // namespace detail
+
 template <typename T>
 class Promise
 {
@@ -44,6 +52,16 @@ class Promise
 
   void SetError(Error error);
 
+  // Called with the error passed to `Future::Cancel` on this promise's
+  // future, or on any future chained from it with `Then` or `Within` (or
+  // with the timeout error when a `Within` times out), so the producer can
+  // stop early (typically by failing the promise with that error). Runs
+  // at most once: on the cancelling thread, or right here if the future was
+  // cancelled already. Never runs once the promise is fulfilled, but may run
+  // while another thread is fulfilling it.
+  template <class F>
+  void SetInterruptHandler(F&& handler);
+
   bool IsFulfilled();
 
   void Detach();
@@ -52,13 +70,29 @@ class Promise
   typedef typename Future<T>::SharedDataPtr SharedDataPtr;
   template <class>
   friend class Future;
+  friend class detail::PromiseBatch<T>;
 
-  bool retrieved_;
   SharedDataPtr shared_;
 
   void SetTry(Try<T>&& t);
 };  // class Promise
 
+// Fulfils `promises[i]` with `values[i]`, moving from `values`: all results
+// are published in a first pass and the continuations that became due run in
+// a second, in order. With an `executor` the second pass is a single task
+// there, instead of running on the calling thread. For one response that
+// answers many requests:
+//
+//   FulfilBatch<Reply>(pending_promises, replies);
+template <class T>
+void FulfilBatch(Span<Promise<T>> promises, Span<T> values,
+                 Executor* executor = nullptr);
+
+// As `FulfilBatch`, failing every promise with a copy of `error`.
+template <class T>
+void FailAll(Span<Promise<T>> promises, const Error& error,
+             Executor* executor = nullptr);
+
 }  // namespace dien
 
 #include "promise_impl.hpp"
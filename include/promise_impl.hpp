@@ -9,30 +9,28 @@
 
 #pragma once
 
+#include <vector>
+
 #include "shared_data.hpp"
 
 namespace dien
 {
 
 template <typename T>
-Promise<T>::Promise()
-    : retrieved_(false), shared_(new SharedData<T>())
+Promise<T>::Promise() : shared_(new SharedData<T>())
 {
 }
 
 template <class T>
-Promise<T>::Promise(Promise<T>&& other) noexcept : retrieved_(other.retrieved_),
-                                                   shared_(other.shared_)
+Promise<T>::Promise(Promise<T>&& other) noexcept : shared_(other.shared_)
 {
   other.shared_ = nullptr;
-  other.retrieved_ = false;
 }
 
 template <class T>
 Promise<T>& Promise<T>::operator=(Promise<T>&& other) noexcept
 {
   std::swap(shared_, other.shared_);
-  std::swap(retrieved_, other.retrieved_);
   return *this;
 }
 
@@ -40,7 +38,7 @@ template <class T>
 Promise<T>::~Promise()
 {
   if (shared_) {
-    if (!retrieved_) {
+    if (!shared_->FutureRetrieved()) {
       shared_->DetachFuture();
     }
 
@@ -53,9 +51,9 @@ template <class T>
 Future<T> Promise<T>::GetFuture()
 {
   assert(shared_);
-  assert(!retrieved_);
+  assert(!shared_->FutureRetrieved());
 
-  retrieved_ = true;
+  shared_->SetFutureRetrieved();
   return Future<T>(shared_);
 }
 
@@ -122,10 +120,121 @@ void Promise<T>::SetError(Error e)
   shared_->SetResult(Try<T>(std::move(e)));
 }
 
+template <class T>
+template <class F>
+void Promise<T>::SetInterruptHandler(F&& handler)
+{
+  assert(shared_);
+
+  shared_->SetInterruptHandler(InterruptHandler(std::forward<F>(handler)));
+}
+
 template <class T>
 bool Promise<T>::IsFulfilled()
 {
   return (shared_ && shared_->HasResult());
 }
 
+namespace detail
+{
+
+// Fulfils `promise` with whatever `t` holds.
+template <class T>
+void Fulfil(Promise<T>& promise, Try<T>&& t)
+{
+  if (t.HasError()) {
+    promise.SetError(std::move(t.GetError()));
+  } else {
+    promise.SetWith([&t]() { return std::move(t).Value(); });
+  }
+}
+
+template <class T>
+class PromiseBatch
+{
+ public:
+  static void Fulfil(Span<Promise<T>> promises, Span<T> values,
+                     Executor* executor)
+  {
+    CHECK_EQ(promises.size(), values.size())
+        << "FulfilBatch needs one value per promise";
+
+    T* value = values.begin();
+    bool fuse = !executor;
+    Run(promises, executor, [&value, fuse](SharedData<T>* shared) {
+      return shared->SetResultDeferred(Try<T>(std::move(*value++)), fuse);
+    });
+  }
+
+  static void Fail(Span<Promise<T>> promises, const Error& error,
+                   Executor* executor)
+  {
+    bool fuse = !executor;
+    Run(promises, executor, [&error, fuse](SharedData<T>* shared) {
+      return shared->SetErrorDeferred(error, fuse);
+    });
+  }
+
+ private:
+  // `publish` stores and publishes one result, returning whether a
+  // continuation is due. Continuations only run once every result is out,
+  // so none of them sees a batch half fulfilled.
+  template <class Publish>
+  static void Run(Span<Promise<T>> promises, Executor* executor,
+                  Publish&& publish)
+  {
+    if (!executor) {
+      for (Promise<T>& promise : promises) {
+        assert(promise.shared_);
+        publish(promise.shared_);
+      }
+
+      // A no-op on the states that had no continuation yet.
+      for (Promise<T>& promise : promises) {
+        promise.shared_->RunDeferred();
+      }
+
+      return;
+    }
+
+    // Held until the executor gets round to them: the promises may be gone
+    // by then, so nothing is left unpublished.
+    std::vector<SharedData<T>*> due;
+    for (Promise<T>& promise : promises) {
+      assert(promise.shared_);
+      if (publish(promise.shared_)) {
+        promise.shared_->AttachOne();
+        due.push_back(promise.shared_);
+      }
+    }
+
+    if (due.empty()) {
+      return;
+    }
+
+    executor->Add([duem = std::move(due)]() {
+      for (SharedData<T>* shared : duem) {
+        shared->DoCallback();
+        shared->DetachOne();
+      }
+    });
+  }
+};  // class PromiseBatch
+
+}  // namespace detail
+
+template <class T>
+void FulfilBatch(Span<Promise<T>> promises, Span<T> values,
+                 Executor* executor)
+{
+  detail::PromiseBatch<T>::Fulfil(promises, values, executor);
+}
+
+template <class T>
+void FailAll(Span<Promise<T>> promises, const Error& error,
+             Executor* executor)
+{
+  detail::PromiseBatch<T>::Fail(promises, error, executor);
+}
+
 }  // namespace dien
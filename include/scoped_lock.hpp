@@ -3,30 +3,145 @@
  *  File:   scoped_lock.hpp
  *  Author: Jojy G Varghese
  *
- *  Description: An RAII based lock for std::atomic_flag
+ *  Description: A word sized lock with pluggable waiting policies and an
+ *              RAII guard for it.
  *
  ******************************************************************************/
 
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "park.hpp"
 
 namespace dien
 {
 
+// A waiting policy is asked what to do after each failed acquire attempt.
+// `Wait` returns false once the waiter should stop spinning and park.
+
+// Busy spin on the lock word forever.
+struct SpinPolicy
+{
+  static bool Wait(unsigned /* attempt */)
+  {
+    return true;
+  }
+};
+
+// Exponential backoff with the CPU pause instruction, then yield the time
+// slice. Never parks.
+struct YieldPolicy
+{
+  static const unsigned kSpinAttempts = 7;
+
+  static bool Wait(unsigned attempt)
+  {
+    if (attempt < kSpinAttempts) {
+      for (unsigned i = 0; i < (1u << attempt); i++) {
+        CpuRelax();
+      }
+    } else {
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+};
+
+// Exponential backoff, then a few yields, then park on the lock word. Suited
+// to boxes that run more threads than cores, where a preempted holder would
+// otherwise make waiters burn whole time slices.
+struct ParkPolicy
+{
+  static const unsigned kSpinAttempts = 7;
+  static const unsigned kYieldAttempts = 4;
+
+  static bool Wait(unsigned attempt)
+  {
+    if (attempt >= kSpinAttempts + kYieldAttempts) {
+      return false;
+    }
+
+    return YieldPolicy::Wait(attempt);
+  }
+};
+
+// Lock word states: 0 unlocked, 1 locked, 2 locked with (possibly) parked
+// waiters. Only the parking path ever stores 2, so the spinning policies
+// never pay for a wake-up syscall on unlock.
+template <class Policy = ParkPolicy>
+class SpinLock
+{
+ public:
+  SpinLock() : word_(kUnlocked)
+  {
+  }
+
+  SpinLock(const SpinLock&) = delete;
+  SpinLock& operator=(const SpinLock&) = delete;
+
+  bool TryLock()
+  {
+    uint32_t expected = kUnlocked;
+    return word_.compare_exchange_strong(expected, kLocked,
+                                         std::memory_order_acquire);
+  }
+
+  void Lock()
+  {
+    for (unsigned attempt = 0;; attempt++) {
+      if (word_.load(std::memory_order_relaxed) == kUnlocked && TryLock()) {
+        return;
+      }
+
+      if (!Policy::Wait(attempt)) {
+        break;
+      }
+    }
+
+    while (word_.exchange(kContended, std::memory_order_acquire) !=
+           kUnlocked) {
+      Park(word_, kContended);
+    }
+  }
+
+  void Unlock()
+  {
+    if (word_.exchange(kUnlocked, std::memory_order_release) == kContended) {
+      UnparkOne(word_);
+    }
+  }
+
+ private:
+  enum : uint32_t {
+    kUnlocked,
+    kLocked,
+    kContended,
+  };
+
+  std::atomic<uint32_t> word_;
+};  // class SpinLock
+
+template <class Policy = ParkPolicy>
 struct ScopedLock
 {
-  ScopedLock(std::atomic_flag& flag) : lock_(flag)
+  ScopedLock(SpinLock<Policy>& lock) : lock_(lock)
   {
-    while (lock_.test_and_set(std::memory_order_acquire)) {}
+    lock_.Lock();
   }
 
   ~ScopedLock()
   {
-    lock_.clear(std::memory_order_release);
+    lock_.Unlock();
   }
 
-  std::atomic_flag& lock_;
+  ScopedLock(const ScopedLock&) = delete;
+  ScopedLock& operator=(const ScopedLock&) = delete;
+
+  SpinLock<Policy>& lock_;
 };  // ScopedLock
 
 }  // namespace dien
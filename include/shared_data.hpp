@@ -11,17 +11,35 @@
 #pragma once
 
 #include <atomic>
-#include <mutex>
 #include <cassert>
+#include <glog/logging.h>
 
-#include "option.hpp"
+#include "allocator.hpp"
+#include "executor.hpp"
+#include "inline_function.hpp"
+#include "interrupt.hpp"
+#include "park.hpp"
 #include "scoped_lock.hpp"
 #include "try.hpp"
 
 namespace dien
 {
 
-enum State : uint8_t {
+// States of the `SharedData` state machine, kept in the low bits of
+// `SharedData::state_` together with the flags and attachment count below.
+// Every transition is a single CAS of the whole word:
+//
+//   kStart --SetResult--> kOnlyResult --SetCallback--> kDone
+//   kStart --SetCallback--> kOnlyCallback --SetResult--> kDone
+//
+// The second step goes through kArmed instead when the state is inactive
+// (or the result is deferred, see `SetResultDeferred`); whoever then moves
+// kArmed to kDone runs the callback.
+//
+// `result_` is written only by the producer before it publishes kOnlyResult
+// or kArmed, and `callback_` only by the consumer before it publishes
+// kOnlyCallback or kArmed, so neither field needs a lock.
+enum State : uint32_t {
   kStart,
   kOnlyResult,
   kOnlyCallback,
@@ -29,6 +47,155 @@ enum State : uint8_t {
   kDone
 };
 
+// Or-ed into the state by a producer publishing an error. Together with the
+// state it is the only record of what `SharedData::result_` holds.
+const uint32_t kErrorResult = 1u << 3;
+const uint32_t kStateMask = kErrorResult - 1;
+
+// Cleared while callbacks are held back (see `SharedData::Deactivate`).
+const uint32_t kActive = 1u << 4;
+
+// Set by the Promise once it has handed out its Future.
+const uint32_t kFutureRetrieved = 1u << 5;
+
+// The rest of the word counts attachments: the Promise, the Future and each
+// continuation waiting on an executor hold one, and the last to detach frees
+// the state. Sharing the word lets a transition take one in the same CAS.
+const uint32_t kAttachedShift = 8;
+const uint32_t kAttachedOne = 1u << kAttachedShift;
+
+// Debug builds count the read-modify-writes made on state words, so that
+// tests can pin down what a future's lifetime costs.
+#ifndef DIEN_COUNT_ATOMIC_OPS
+#ifdef NDEBUG
+#define DIEN_COUNT_ATOMIC_OPS 0
+#else
+#define DIEN_COUNT_ATOMIC_OPS 1
+#endif
+#endif
+
+const size_t kCacheLineSize = 64;
+
+// Selects the field layout of `SharedData<T>`. The default packs everything
+// into one line's worth of bytes, which suits futures that are fulfilled and
+// consumed on the same thread. Specialize to `std::true_type` for types whose
+// futures routinely cross threads: the control words, the producer-written
+// result and the consumer-written callback then get a cache line each, so
+// the two sides stop invalidating each other's lines.
+template <class T>
+struct SplitSharedDataLayout : std::false_type
+{};
+
+// Bytes of inline storage for the callback of a `SharedData<T>`: the
+// Promise of a `Then` link plus the user's continuation. The split layout
+// gives the callback a line of its own, which fits the `InlineFunction`
+// default of 48; the compact layout keeps 24 (a Promise and two pointers) so
+// that `SharedData<int>` fits one line. Specialize for types whose
+// continuations capture more, to keep them off the heap.
+template <class T>
+struct SharedDataCallbackCapacity
+    : std::integral_constant<size_t, SplitSharedDataLayout<T>::value
+                                         ? kInlineFunctionCapacity
+                                         : 24>
+{};
+
+namespace detail
+{
+
+// A `SharedData` result, stored in place. Constructed by the producer and
+// destroyed with the `SharedData`; which member is live is in the state.
+template <class T>
+union ResultStorage
+{
+  ResultStorage()
+  {
+  }
+
+  ~ResultStorage()
+  {
+  }
+
+  T value;
+  Error error;
+};
+
+template <>
+union ResultStorage<void>
+{
+  ResultStorage()
+  {
+  }
+
+  ~ResultStorage()
+  {
+  }
+
+  Error error;
+};
+
+#if DIEN_COUNT_ATOMIC_OPS
+// Read-modify-writes this thread has made on `SharedData` state words.
+inline uint64_t &SharedDataAtomicOps()
+{
+  static thread_local uint64_t count = 0;
+  return count;
+}
+
+inline void CountAtomicOp()
+{
+  SharedDataAtomicOps()++;
+}
+#else
+inline void CountAtomicOp()
+{
+}
+#endif
+
+// Compact layout, hot fields first: the state word and the result, which
+// every transition touches, lead; `executor_` is only read when a
+// continuation is dispatched.
+template <class T, bool Split>
+class SharedDataFields
+{
+ protected:
+  explicit SharedDataFields(uint32_t state) : state_(state)
+  {
+  }
+
+  std::atomic<uint32_t> state_;
+  std::atomic<uint32_t> waiters_{0};
+  ResultStorage<T> result_;
+  // Ahead of `callback_`, so that it outlives the links the callback owns.
+  InterruptSlot interrupt_;
+  InlineFunction<void(Try<T> &&), SharedDataCallbackCapacity<T>::value>
+      callback_;
+  Executor *executor_ = nullptr;
+};
+
+// Split layout: one line of control words both sides read and CAS, one
+// written only by the producer and one written only by the consumer.
+template <class T>
+class SharedDataFields<T, true>
+{
+ protected:
+  explicit SharedDataFields(uint32_t state) : state_(state)
+  {
+  }
+
+  alignas(kCacheLineSize) std::atomic<uint32_t> state_;
+  std::atomic<uint32_t> waiters_{0};
+  InterruptSlot interrupt_;
+
+  alignas(kCacheLineSize) ResultStorage<T> result_;
+
+  alignas(kCacheLineSize)
+      InlineFunction<void(Try<T> &&), SharedDataCallbackCapacity<T>::value>
+          callback_;
+  Executor *executor_ = nullptr;
+};
+
+}  // namespace detail
+
 template <class T>
 class Future;
 
@@ -37,20 +204,33 @@ class Promise;
 
 template <typename T, bool OnStack = false>
 class SharedData
+    : private detail::SharedDataFields<T, SplitSharedDataLayout<T>::value>
 {
+  typedef detail::SharedDataFields<T, SplitSharedDataLayout<T>::value>
+      Fields;
+
  public:
-  SharedData() : result_(), state_(kStart), attached_(2)
+  SharedData() : Fields(kStart | kActive | 2 * kAttachedOne)
   {
   }
 
-  explicit SharedData(Try<T> &&v)
-      : result_(std::move(v)), state_(kOnlyResult), attached_(1)
+  explicit SharedData(Try<T> &&v) : Fields(kStart | kActive | kAttachedOne)
   {
+    state_.store(state_.load(std::memory_order_relaxed) | kOnlyResult |
+                     StoreResult(std::move(v)),
+                 std::memory_order_relaxed);
   }
 
   ~SharedData()
   {
-    if (!OnStack) assert(attached_ == 0);
+    if (!OnStack) {
+      assert(state_.load(std::memory_order_relaxed) < kAttachedOne);
+    }
+
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (IsReadyState(state)) {
+      DestroyResult(state);
+    }
   }
 
   SharedData(const SharedData &) = delete;
@@ -59,165 +239,302 @@ class SharedData
   SharedData(const SharedData &&) = delete;
   SharedData &operator=(const SharedData &&) = delete;
 
-  // unlocked version
-  bool Ready_() const
+  // Heap allocated nodes come from the installed `BlockAllocator` (per-thread
+  // pools unless overridden with `SetBlockAllocator`).
+  static void *operator new(size_t size)
   {
-    switch (state_) {
-      case(State::kOnlyResult) :
-      case(State::kArmed) :
-      case(State::kDone) :
-        assert(!!result_);
-        return true;
+    if (kOverAligned) {
+      return AllocateAlignedBlock(size, alignof(SharedData));
+    }
+
+    return AllocateBlock(size);
+  }
 
-      default:
-        return false;
+  static void operator delete(void *p, size_t size)
+  {
+    if (kOverAligned) {
+      DeallocateAlignedBlock(p, size, alignof(SharedData));
+    } else {
+      DeallocateBlock(p, size);
     }
   }
 
+  static bool IsReadyState(uint32_t state)
+  {
+    state &= kStateMask;
+    return state == State::kOnlyResult || state == State::kArmed ||
+           state == State::kDone;
+  }
+
   bool Ready() const
   {
-    ScopedLock lock(lock_);
+    return IsReadyState(state_.load(std::memory_order_acquire));
+  }
+
+  // Blocks until `Ready()` or until `deadline` passes; returns `Ready()`.
+  // Spins briefly (see `ParkPolicy`) before parking on the state word, and
+  // costs a single load when already ready.
+  bool WaitUntil(Deadline deadline)
+  {
+    for (unsigned attempt = 0; !Ready(); attempt++) {
+      if (!ParkPolicy::Wait(attempt)) {
+        break;
+      }
+    }
 
-    return Ready_();
+    if (Ready()) {
+      return true;
+    }
+
+    // Announce ourselves before re-reading the state: `SetResult` publishes
+    // the state before it reads `waiters_`, so one of us sees the other.
+    waiters_.fetch_add(1);
+
+    for (;;) {
+      uint32_t state = state_.load();
+      if (IsReadyState(state)) {
+        break;
+      }
+
+      if (deadline == Deadline::max()) {
+        Park(state_, state);
+      } else if (!ParkUntil(state_, state, deadline)) {
+        break;
+      }
+    }
+
+    waiters_.fetch_sub(1);
+
+    return Ready();
+  }
+
+  // A copy of the result.
+  Try<T> GetTry() const
+  {
+    uint32_t state = state_.load(std::memory_order_acquire);
+    assert(IsReadyState(state));
+
+    if (state & kErrorResult) {
+      return Try<T>(result_.error);
+    }
+
+    return CopyValue(IsVoid());
   }
 
   template <class Q = T>
   typename std::enable_if<!std::is_same<Q, void>::value, T>::type &Get()
   {
-    ScopedLock lock(lock_);
+    assert(Ready() && !HasError());
 
-    assert(Ready_());
-
-    return result_->Value();
+    return result_.value;
   }
 
   bool HasError() const
   {
-    ScopedLock lock(lock_);
-
-    return result_->HasError();
+    uint32_t state = state_.load(std::memory_order_acquire);
+    return IsReadyState(state) && (state & kErrorResult);
   }
 
   template <typename F>
   void SetCallback(F &&fn)
   {
-    bool transition_armed = false;
-
-    {
-      ScopedLock lock(lock_);
-
-      switch (state_) {
-        case(State::kStart) :
-          state_ = State::kOnlyCallback;
-          callback_ = std::forward<F>(fn);
-          break;
-
-        case(State::kOnlyResult) :
-          state_ = State::kArmed;
-          callback_ = std::forward<F>(fn);
-          transition_armed = true;
-          break;
-
-        case(State::kOnlyCallback) :
-        case(State::kArmed) :
-        case(State::kDone) :
-          CHECK_NE(true, false) << "SetCallback called twice";
+    // Not visible to the producer until the state below is published.
+    callback_ = std::forward<F>(fn);
+
+    uint32_t word = state_.load(std::memory_order_acquire);
+    for (;;) {
+      uint32_t next;
+      if ((word & kStateMask) == State::kStart) {
+        next = word | State::kOnlyCallback;
+      } else {
+        // Only the producer can have moved us out of kStart.
+        CHECK_EQ(word & kStateMask, State::kOnlyResult)
+            << "SetCallback called twice";
+        next = Fire(word);
       }
-    }
 
-    if (transition_armed) {
-      DoCallback();
+      detail::CountAtomicOp();
+      if (state_.compare_exchange_weak(word, next)) {
+        if ((next & kStateMask) == State::kDone) {
+          Dispatch(next);
+        }
+        return;
+      }
     }
   }
 
   void SetResult(Try<T> &&result)
   {
-    bool transition_armed = false;
+    CHECK(!Ready()) << "SetResult called twice";
 
-    {
-      ScopedLock lock(lock_);
+    // Not visible to the consumer until the state below is published.
+    PublishResult(StoreResult(std::move(result)));
+  }
 
-      switch (state_) {
-        case(State::kStart) :
-          state_ = State::kOnlyResult;
-          result_ = std::move(result);
-          break;
+  // `SetResult` without running the callback, for fulfilling many states
+  // in one pass (see `FulfilBatch`). Returns whether a callback is due; the
+  // caller runs it with `RunDeferred`. With `fuse`, a fused state (see
+  // `Fused`) is not published at all but left for `RunDeferred` to finish
+  // in line, so the caller must do that before letting go of the state.
+  bool SetResultDeferred(Try<T> &&result, bool fuse)
+  {
+    CHECK(!Ready()) << "SetResult called twice";
 
-        case(State::kOnlyCallback) :
-          state_ = State::kArmed;
-          result_ = std::move(result);
-          transition_armed = true;
-          break;
+    return PublishDeferred(StoreResult(std::move(result)), fuse);
+  }
 
-        case(State::kOnlyResult) :
-        case(State::kArmed) :
-        case(State::kDone) :
-          CHECK_NE(true, false) << "SetCallback called twice";
-      }
+  bool SetErrorDeferred(const Error &error, bool fuse)
+  {
+    CHECK(!Ready()) << "SetResult called twice";
+
+    new (&result_.error) Error(error);
+    return PublishDeferred(kErrorResult, fuse);
+  }
+
+  // The second half of a deferred `SetResult`.
+  void RunDeferred()
+  {
+    uint32_t word = state_.load(std::memory_order_relaxed);
+    if ((word & kStateMask) == State::kOnlyCallback) {
+      state_.store((word & ~kStateMask) | State::kDone,
+                   std::memory_order_relaxed);
+      callback_(TakeResult(word));
+      return;
     }
 
-    if (transition_armed) {
-      DoCallback();
+    DoCallback();
+  }
+
+  void WakeWaiters()
+  {
+    if (waiters_.load() != 0) {
+      UnparkAll(state_);
     }
   }
 
+  // Nothing can be waiting on `Activate` unless someone deactivated us.
   void DetachFuture()
   {
-    Activate();
+    if (!IsActive()) {
+      Activate();
+    }
+
     DetachOne();
   }
 
   void DetachPromise()
   {
-    if (!result_) {
-      result_ = Try<T>(Error("Broken Promise"));
+    if (!Ready()) {
+      new (&result_.error) Error(ErrorCode(kBrokenPromise));
+      PublishResult(kErrorResult);
     }
 
     DetachOne();
   }
 
+  // Holds the callback back until `Activate`: a result arriving meanwhile
+  // leaves the state kArmed.
   void Deactivate()
   {
-    active_.store(false, std::memory_order_release);
+    detail::CountAtomicOp();
+    state_.fetch_and(~kActive);
   }
 
+  // The flag shares the word with the state, so an `Activate` racing with
+  // the result either lands first, and the result goes straight to kDone,
+  // or finds kArmed.
   void Activate()
   {
-    active_.store(true, std::memory_order_release);
+    detail::CountAtomicOp();
+    state_.fetch_or(kActive);
     DoCallback();
   }
 
   bool IsActive()
   {
-    return active_.load(std::memory_order_acquire);
+    return state_.load(std::memory_order_acquire) & kActive;
   }
 
-  void DoCallback()
+  // Cancellation, from the consumer back to the producer; see
+  // `InterruptSlot`. Nothing is installed once the result is in: `Publish`
+  // may not have closed the slot.
+  void SetInterruptHandler(InterruptHandler &&handler)
   {
-    ScopedLock lock(lock_);
+    if (!Ready()) {
+      interrupt_.SetHandler(std::move(handler));
+    }
+  }
 
-    switch (state_) {
-      case(State::kArmed) :
-        if (active_.load(std::memory_order_acquire)) {
-          state_ = State::kDone;
-          callback_(std::move(result_.Value()));
-        }
-        break;
+  void ForwardInterrupts(detail::InterruptSlot *upstream)
+  {
+    if (!Ready()) {
+      interrupt_.SetForward(upstream);
+    }
+  }
 
-      default:
-        break;
+  // For a state whose Promise and Future have not left the caller yet.
+  void InitForwardInterrupts(detail::InterruptSlot *upstream)
+  {
+    interrupt_.InitForward(upstream);
+  }
+
+  void Interrupt(const Error &error)
+  {
+    if (!Ready()) {
+      interrupt_.Raise(error);
     }
   }
 
+  detail::InterruptSlot *GetInterruptSlot()
+  {
+    return &interrupt_;
+  }
+
+  // Set by the consumer before the callback is attached; published to the
+  // producer by the same CAS that publishes the callback.
+  void SetExecutor(Executor *executor)
+  {
+    executor_ = executor;
+  }
+
+  Executor *GetExecutor() const
+  {
+    return executor_;
+  }
+
+  // Runs the callback if the state is armed and active. Several threads may
+  // race here (producer, consumer and `Activate`); the CAS elects exactly
+  // one of them.
+  void DoCallback()
+  {
+    uint32_t word = state_.load();
+    while ((word & kStateMask) == State::kArmed && (word & kActive)) {
+      uint32_t next = Fire(word);
+      detail::CountAtomicOp();
+      if (state_.compare_exchange_weak(word, next)) {
+        Dispatch(next);
+        return;
+      }
+    }
+  }
+
+  // Another reference, dropped with `DetachOne`.
+  void AttachOne()
+  {
+    detail::CountAtomicOp();
+    state_.fetch_add(kAttachedOne);
+  }
+
   void DetachOne()
   {
     if (OnStack) return;
 
-    auto a = attached_--;
+    detail::CountAtomicOp();
+    uint32_t word = state_.fetch_sub(kAttachedOne);
 
-    assert(a >= 1);
+    assert(word >= kAttachedOne);
 
-    if (a == 1) {
+    if (word < 2 * kAttachedOne) {
       delete this;
     }
   }
@@ -228,12 +545,220 @@ class SharedData
   template <class>
   friend class Promise;
 
-  mutable std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
-  std::function<void(Try<T> &&)> callback_;
-  Option<Try<T>> result_;
-  State state_;
-  std::atomic<bool> active_{true};
-  std::atomic<unsigned int> attached_;
+  using Fields::state_;
+  using Fields::waiters_;
+  using Fields::result_;
+  using Fields::callback_;
+  using Fields::executor_;
+  using Fields::interrupt_;
+
+  static const bool kOverAligned =
+      SplitSharedDataLayout<T>::value &&
+      kCacheLineSize > detail::kBlockHeaderSize;
+
+  typedef std::integral_constant<bool, std::is_void<T>::value> IsVoid;
+
+  // Owned by the Promise. Set before its Future exists, when no other
+  // thread can be writing the word, so it costs no read-modify-write.
+  bool FutureRetrieved() const
+  {
+    return state_.load(std::memory_order_relaxed) & kFutureRetrieved;
+  }
+
+  void SetFutureRetrieved()
+  {
+    state_.store(state_.load(std::memory_order_relaxed) | kFutureRetrieved,
+                 std::memory_order_relaxed);
+  }
+
+  // Publishes the result already stored in `result_`; `error` is its flag.
+  void PublishResult(uint32_t error)
+  {
+    uint32_t word = state_.load(std::memory_order_acquire);
+    if (Fused(word) && interrupt_.Idle()) {
+      // Nobody else can observe us: run the callback in line, as the link
+      // of a synchronous chain it is, and skip the handshake. A forward
+      // left in `interrupt_` is only followed from downstream states this
+      // callback fulfils (or re-forwards) before it returns.
+      state_.store((word & ~kStateMask) | State::kDone | error,
+                   std::memory_order_relaxed);
+      callback_(TakeResult(error));
+      return;
+    }
+
+    uint32_t next = Publish(error, true);
+    if ((next & kStateMask) == State::kDone) {
+      Dispatch(next);
+    }
+  }
+
+  // Nobody but us can see a fused state: it keeps kOnlyCallback, with the
+  // error flag, until `RunDeferred`.
+  bool PublishDeferred(uint32_t error, bool fuse)
+  {
+    uint32_t word = state_.load(std::memory_order_acquire);
+    if (fuse && Fused(word) && interrupt_.Idle()) {
+      state_.store(word | error, std::memory_order_relaxed);
+      return true;
+    }
+
+    return (Publish(error, false) & kStateMask) == State::kArmed;
+  }
+
+  // Publishes the result and wakes waiters, returning the new word: the
+  // callback, if there is one, is left armed for `DoCallback`, or with
+  // `claim` on an active state moved straight to kDone for the caller to
+  // `Dispatch`, which saves a second CAS.
+  uint32_t Publish(uint32_t error, bool claim)
+  {
+    // A raise that lands in an empty slot after this is only recorded, and
+    // freed with us; no handler is installed once we are ready.
+    if (!interrupt_.Empty()) {
+      detail::CountAtomicOp();
+      interrupt_.Close();
+    }
+
+    uint32_t word = state_.load(std::memory_order_acquire);
+    for (;;) {
+      uint32_t next;
+      if ((word & kStateMask) == State::kStart) {
+        next = word | State::kOnlyResult | error;
+      } else {
+        // Only the consumer can have moved us out of kStart.
+        CHECK_EQ(word & kStateMask, State::kOnlyCallback)
+            << "SetResult called twice";
+        next = claim ? Fire(word | error)
+                     : (word & ~kStateMask) | State::kArmed | error;
+      }
+
+      detail::CountAtomicOp();
+      if (state_.compare_exchange_weak(word, next)) {
+        WakeWaiters();
+        return next;
+      }
+    }
+  }
+
+  // The word that runs the callback of `word`, which holds both a result
+  // and a callback: kDone if active, taking an attachment for the executor
+  // task if there is one, or else kArmed to wait for `Activate`.
+  uint32_t Fire(uint32_t word) const
+  {
+    word &= ~kStateMask;
+    if (!(word & kActive)) {
+      return word | State::kArmed;
+    }
+
+    return (word | State::kDone) + (executor_ ? kAttachedOne : 0);
+  }
+
+  // Runs the callback of a state this thread has just moved to kDone.
+  void Dispatch(uint32_t word)
+  {
+    if (!executor_) {
+      callback_(TakeResult(word));
+      return;
+    }
+
+    // The attachment taken with kDone keeps us alive until the executor
+    // gets round to the callback.
+    executor_->Add([this, word]() {
+      callback_(TakeResult(word));
+      DetachOne();
+    });
+  }
+
+  // True once the only party left is the producer and the callback it is
+  // about to fulfil runs in line: the intermediate states of a chain like
+  // `f.Then(a).Then(b)` whose futures were consumed by `Then`. The future is
+  // gone, so there are no waiters and no second `SetCallback`, and the
+  // acquire that loaded `word` pairs with the release of the detach in
+  // `DetachFuture`, making `callback_` and `executor_` visible.
+  bool Fused(uint32_t word) const
+  {
+    return !OnStack &&
+           (word & ~kFutureRetrieved) ==
+               (State::kOnlyCallback | kActive | kAttachedOne) &&
+           !executor_;
+  }
+
+  // Constructs the result in place and returns the state flag recording
+  // which kind it is.
+  uint32_t StoreResult(Try<T> &&result)
+  {
+    if (result.HasError()) {
+      new (&result_.error) Error(std::move(result.GetError()));
+      return kErrorResult;
+    }
+
+    assert(result.HasValue());
+    StoreValue(std::move(result), IsVoid());
+    return 0;
+  }
+
+  void StoreValue(Try<T> &&result, std::false_type)
+  {
+    new (&result_.value) T(std::move(result).Value());
+  }
+
+  void StoreValue(Try<T> &&, std::true_type)
+  {
+  }
+
+  // Moves the result out for the callback; the moved-from storage is still
+  // destroyed with us.
+  Try<T> TakeResult(uint32_t state)
+  {
+    if (state & kErrorResult) {
+      return Try<T>(std::move(result_.error));
+    }
+
+    return TakeValue(IsVoid());
+  }
+
+  Try<T> TakeValue(std::false_type)
+  {
+    return Try<T>(std::move(result_.value));
+  }
+
+  Try<T> TakeValue(std::true_type)
+  {
+    return Try<T>();
+  }
+
+  Try<T> CopyValue(std::false_type) const
+  {
+    return Try<T>(result_.value);
+  }
+
+  Try<T> CopyValue(std::true_type) const
+  {
+    return Try<T>();
+  }
+
+  void DestroyResult(uint32_t state)
+  {
+    if (state & kErrorResult) {
+      result_.error.~Error();
+    } else {
+      DestroyValue(IsVoid());
+    }
+  }
+
+  void DestroyValue(std::false_type)
+  {
+    result_.value.~T();
+  }
+
+  void DestroyValue(std::true_type)
+  {
+  }
+
 }; // class SharedData
 
+static_assert(sizeof(SharedData<int>) <= kCacheLineSize,
+              "SharedData<int> should fit in a cache line");
+static_assert(sizeof(SharedData<void *>) <= kCacheLineSize,
+              "SharedData<T*> should fit in a cache line");
+
 }  // namespace dien
@@ -0,0 +1,380 @@
+/******************************************************************************
+ *
+ *  File:   shared_future.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `SharedFuture`, a copyable handle on one result that any
+ *              number of continuations read in place.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "allocator.hpp"
+#include "future.hpp"
+#include "inline_function.hpp"
+#include "option.hpp"
+
+namespace dien
+{
+
+namespace detail
+{
+
+// Calls a `SharedFuture::Then` continuation with the value, or with nothing
+// for `void`.
+template <class T>
+struct SharedApply
+{
+  template <class F>
+  static auto Apply(F& func, const Try<T>& t) -> decltype(func(t.Value()))
+  {
+    return func(t.Value());
+  }
+};
+
+template <>
+struct SharedApply<void>
+{
+  template <class F>
+  static auto Apply(F& func, const Try<void>&) -> decltype(func())
+  {
+    return func();
+  }
+};
+
+// The result and a lock-free list of the continuations waiting for it.
+// `head_` is the last continuation added (each links to the one before), or
+// `kDone` once the result is in, after which continuations run as they are
+// added. The first continuation lives in the state itself, so a single
+// consumer costs no more than a plain `Future`.
+template <class T>
+class SharedFutureState
+{
+ public:
+  typedef InlineFunction<void(const Try<T>&)> Callback;
+
+  SharedFutureState() : head_(0), first_claimed_(false), refs_(1)
+  {
+  }
+
+  ~SharedFutureState()
+  {
+    uintptr_t head = head_.load(std::memory_order_acquire);
+    if (head != kDone) {
+      Free(reinterpret_cast<Node*>(head));
+    }
+  }
+
+  SharedFutureState(const SharedFutureState&) = delete;
+  SharedFutureState& operator=(const SharedFutureState&) = delete;
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void AddRef()
+  {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void Release()
+  {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  bool IsReady() const
+  {
+    return head_.load(std::memory_order_acquire) == kDone;
+  }
+
+  // Only once `IsReady`.
+  const Try<T>& Result() const
+  {
+    assert(IsReady());
+    return result_.Value();
+  }
+
+  // Runs `func` with the result, here if it is already in.
+  template <class F>
+  void Add(F&& func)
+  {
+    uintptr_t head = head_.load(std::memory_order_acquire);
+    if (head == kDone) {
+      func(result_.Value());
+      return;
+    }
+
+    Node* node;
+    if (!first_claimed_.exchange(true, std::memory_order_relaxed)) {
+      node = &first_;
+      node->callback = Callback(std::forward<F>(func));
+    } else {
+      node = new Node(Callback(std::forward<F>(func)));
+    }
+
+    for (;;) {
+      node->next = reinterpret_cast<Node*>(head);
+      if (head_.compare_exchange_weak(head, reinterpret_cast<uintptr_t>(node),
+                                      std::memory_order_release,
+                                      std::memory_order_acquire)) {
+        return;
+      }
+
+      // Fulfilled meanwhile: nobody else will run it.
+      if (head == kDone) {
+        node->callback(result_.Value());
+        Recycle(node);
+        return;
+      }
+    }
+  }
+
+  // Stores the result once and hands it to every waiting continuation, in
+  // the order they were added.
+  void Fulfil(Try<T>&& t)
+  {
+    result_.Emplace(std::move(t));
+
+    Node* node = reinterpret_cast<Node*>(
+        head_.exchange(kDone, std::memory_order_acq_rel));
+
+    Node* ordered = nullptr;
+    while (node) {
+      Node* next = node->next;
+      node->next = ordered;
+      ordered = node;
+      node = next;
+    }
+
+    const Try<T>& result = result_.Value();
+    while (ordered) {
+      Node* next = ordered->next;
+      ordered->callback(result);
+      Recycle(ordered);
+      ordered = next;
+    }
+  }
+
+ private:
+  static const uintptr_t kDone = 1;
+
+  struct Node
+  {
+    Node() : next(nullptr)
+    {
+    }
+
+    explicit Node(Callback&& c) : callback(std::move(c)), next(nullptr)
+    {
+    }
+
+    static void* operator new(size_t size)
+    {
+      return AllocateBlock(size);
+    }
+
+    static void operator delete(void* p, size_t size)
+    {
+      DeallocateBlock(p, size);
+    }
+
+    Callback callback;
+    Node* next;
+  };
+
+  // Drops a continuation that ran. The inline one only releases its
+  // captures.
+  void Recycle(Node* node)
+  {
+    if (node == &first_) {
+      node->callback = Callback();
+    } else {
+      delete node;
+    }
+  }
+
+  void Free(Node* node)
+  {
+    while (node) {
+      Node* next = node->next;
+      if (node != &first_) {
+        delete node;
+      }
+      node = next;
+    }
+  }
+
+  std::atomic<uintptr_t> head_;
+  Option<Try<T>> result_;
+  Node first_;
+  std::atomic<bool> first_claimed_;
+  std::atomic<unsigned int> refs_;
+};  // class SharedFutureState
+
+}  // namespace detail
+
+// A result many consumers wait for. Unlike a `Future`, which takes one
+// continuation and moves its result into it, a `SharedFuture` is copyable
+// and takes any number of continuations; the result is stored once and each
+// continuation reads it by const reference. Continuations run on the thread
+// that fulfils the source future, in the order they were added, or right
+// away once it is ready.
+//
+//   SharedFuture<Config> config(LoadConfig());
+//   config.Then([](const Config& c) { return c.port; });
+//   config.Then([](const Config& c) { return c.name; });
+template <class T>
+class SharedFuture
+{
+ public:
+  typedef T value_type;
+
+  // Consumes `future`; its continuation fulfils this one.
+  explicit SharedFuture(Future<T>&& future)
+      : state_(new detail::SharedFutureState<T>())
+  {
+    state_->AddRef();
+
+    detail::SharedFutureState<T>* state = state_;
+    future.SetCallback_([state](Try<T>&& t) {
+      state->Fulfil(std::move(t));
+      state->Release();
+    });
+  }
+
+  SharedFuture(const SharedFuture& other) : state_(other.state_)
+  {
+    if (state_) {
+      state_->AddRef();
+    }
+  }
+
+  SharedFuture& operator=(const SharedFuture& other)
+  {
+    SharedFuture copy(other);
+    std::swap(state_, copy.state_);
+    return *this;
+  }
+
+  SharedFuture(SharedFuture&& other) noexcept : state_(other.state_)
+  {
+    other.state_ = nullptr;
+  }
+
+  SharedFuture& operator=(SharedFuture&& other) noexcept
+  {
+    std::swap(state_, other.state_);
+    return *this;
+  }
+
+  ~SharedFuture()
+  {
+    if (state_) {
+      state_->Release();
+    }
+  }
+
+  bool IsReady() const
+  {
+    return state_->IsReady();
+  }
+
+  bool HasValue() const
+  {
+    return IsReady() && state_->Result().HasValue();
+  }
+
+  bool HasError() const
+  {
+    return IsReady() && state_->Result().HasError();
+  }
+
+  // Only once ready.
+  const Try<T>& Result() const
+  {
+    return state_->Result();
+  }
+
+  // Runs `func(const Try<T>&)` with the result.
+  template <class F>
+  void SetCallback(F&& func)
+  {
+    state_->Add(std::forward<F>(func));
+  }
+
+  // `func(const T&)` (`func()` for `void`) on success; errors pass through
+  // to the returned future untouched.
+  template <class F,
+            class B = typename std::decay<decltype(detail::SharedApply<T>::Apply(
+                std::declval<F&>(), std::declval<const Try<T>&>()))>::type>
+  Future<B> Then(F&& func)
+  {
+    static_assert(!is_future<B>::value,
+                  "SharedFuture continuations return a value");
+
+    if (state_->IsReady()) {
+      const Try<T>& t = state_->Result();
+      if (t.HasError()) {
+        return Future<B>(Try<B>(t.GetError()));
+      }
+
+      return Future<B>(
+          MakeTryWith([&]() { return detail::SharedApply<T>::Apply(func, t); }));
+    }
+
+    Promise<B> p;
+    Future<B> f = p.GetFuture();
+
+    state_->Add([ pm = std::move(p), funcm = std::forward<F>(func) ](
+        const Try<T>& t) mutable {
+      if (t.HasError()) {
+        pm.SetError(t.GetError());
+      } else {
+        pm.SetWith([&]() { return detail::SharedApply<T>::Apply(funcm, t); });
+      }
+    });
+
+    return f;
+  }
+
+  // A `Future` with its own copy of the result.
+  Future<T> GetFuture()
+  {
+    if (state_->IsReady()) {
+      return Future<T>(Try<T>(state_->Result()));
+    }
+
+    Promise<T> p;
+    Future<T> f = p.GetFuture();
+
+    state_->Add([pm = std::move(p)](const Try<T>& t) mutable {
+      if (t.HasError()) {
+        pm.SetError(t.GetError());
+      } else {
+        pm.SetWith([&]() { return t.Value(); });
+      }
+    });
+
+    return f;
+  }
+
+ private:
+  detail::SharedFutureState<T>* state_;
+};  // class SharedFuture
+
+}  // namespace dien
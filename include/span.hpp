@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ *  File:   span.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `Span`, a non-owning view of contiguous elements.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace dien
+{
+
+// A pointer and a length; what `std::span` would be were we on C++20. Built
+// from a pointer and size, an array, or any container with `data()` and
+// `size()` (`std::vector`, `std::array`). Does not own the elements, which
+// must outlive it.
+template <class T>
+class Span
+{
+ public:
+  typedef T element_type;
+  typedef T* iterator;
+
+  Span() : data_(nullptr), size_(0)
+  {
+  }
+
+  Span(T* data, size_t size) : data_(data), size_(size)
+  {
+  }
+
+  template <size_t N>
+  Span(T (&array)[N]) : data_(array), size_(N)
+  {
+  }
+
+  template <class Container,
+            typename = typename std::enable_if<std::is_convertible<
+                decltype(std::declval<Container&>().data()), T*>::value>::type>
+  Span(Container& container)
+      : data_(container.data()), size_(container.size())
+  {
+  }
+
+  T* data() const
+  {
+    return data_;
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  T& operator[](size_t i) const
+  {
+    assert(i < size_);
+    return data_[i];
+  }
+
+  T* begin() const
+  {
+    return data_;
+  }
+
+  T* end() const
+  {
+    return data_ + size_;
+  }
+
+ private:
+  T* data_;
+  size_t size_;
+};  // class Span
+
+}  // namespace dien
@@ -0,0 +1,725 @@
+/******************************************************************************
+ *
+ *  File:   stream.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: `Stream`, a channel carrying many values from a
+ *              `StreamWriter` to a consumer, delivered in batches with
+ *              bounded buffering.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "allocator.hpp"
+#include "executor.hpp"
+#include "future.hpp"
+#include "inline_function.hpp"
+#include "option.hpp"
+#include "scoped_lock.hpp"
+
+namespace dien
+{
+
+// Elements a writer may have buffered before `Write` asks it to wait.
+const size_t kDefaultStreamCapacity = 1024;
+
+template <class T>
+class Stream;
+
+namespace detail
+{
+
+// The consumer end of a stream, as seen by its source: batches, then one
+// end (success or the writer's error). Returning false from `OnBatch` stops
+// the stream; no end is delivered after that.
+template <class T>
+class StreamSink
+{
+ public:
+  virtual ~StreamSink()
+  {
+  }
+
+  virtual bool OnBatch(std::vector<T>& batch) = 0;
+  virtual void OnEnd(Try<void>&& end) = 0;
+};
+
+template <class T>
+using StreamSinkPtr = std::unique_ptr<StreamSink<T>>;
+
+// Shared by one writer and one reader. Everything but the delivery itself
+// happens under `lock_`; a single deliverer at a time (`delivering_`) hands
+// whatever accumulated to the sink in one call, so elements written while
+// the sink runs, or while a delivery waits on the executor, go out
+// together.
+template <class T>
+class StreamState
+{
+ public:
+  explicit StreamState(size_t capacity)
+      : capacity_(capacity),
+        executor_(nullptr),
+        delivering_(false),
+        cancelled_(false),
+        ended_(false),
+        refs_(2)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  // Ready while the buffer holds fewer than `capacity_` elements, otherwise
+  // once the consumer has taken them. Fails once the reader is gone.
+  Future<void> Write(std::vector<T>* batch, T* value)
+  {
+    lock_.Lock();
+
+    if (cancelled_ || end_) {
+      lock_.Unlock();
+      return Future<void>(FailedFuture(Error(ErrorCode(kCancelled))));
+    }
+
+    if (batch) {
+      if (buffer_.empty()) {
+        buffer_.swap(*batch);
+      } else {
+        std::move(batch->begin(), batch->end(), std::back_inserter(buffer_));
+      }
+    } else {
+      buffer_.push_back(std::move(*value));
+    }
+
+    Future<void> room;
+    if (buffer_.size() >= capacity_) {
+      space_.emplace_back();
+      room = space_.back().GetFuture();
+    }
+
+    Dispatch();
+    return room;
+  }
+
+  void Close(Try<void>&& end)
+  {
+    lock_.Lock();
+
+    if (end_) {
+      lock_.Unlock();
+      return;
+    }
+
+    end_.Emplace(std::move(end));
+    Dispatch();
+  }
+
+  void Attach(StreamSinkPtr<T>&& sink, Executor* executor)
+  {
+    lock_.Lock();
+
+    sink_ = std::move(sink);
+    executor_ = executor;
+    Dispatch();
+  }
+
+  // The reader went away without attaching.
+  void Cancel()
+  {
+    lock_.Lock();
+    cancelled_ = true;
+    buffer_.clear();
+    std::vector<Promise<void>> space(std::move(space_));
+    lock_.Unlock();
+
+    FailWriters(space);
+  }
+
+  bool IsCancelled()
+  {
+    ScopedLock<> guard(lock_);
+    return cancelled_;
+  }
+
+  void Release()
+  {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+ private:
+  static void FailWriters(std::vector<Promise<void>>& space)
+  {
+    for (auto& promise : space) {
+      promise.SetError(Error(ErrorCode(kCancelled)));
+    }
+  }
+
+  // Called with `lock_` held; releases it. Starts a delivery unless one is
+  // already running or scheduled, in which case that one picks up what was
+  // just added.
+  void Dispatch()
+  {
+    if (!sink_ || delivering_ || (buffer_.empty() && !end_)) {
+      lock_.Unlock();
+      return;
+    }
+
+    delivering_ = true;
+
+    if (!executor_) {
+      Deliver();
+      return;
+    }
+
+    refs_.fetch_add(1, std::memory_order_relaxed);
+    lock_.Unlock();
+
+    executor_->Add([this]() {
+      lock_.Lock();
+      Deliver();
+      Release();
+    });
+  }
+
+  // Called with `lock_` held and `delivering_` set; releases the lock.
+  void Deliver()
+  {
+    for (;;) {
+      if (!buffer_.empty()) {
+        batch_.swap(buffer_);
+        std::vector<Promise<void>> space(std::move(space_));
+        space_.clear();
+        lock_.Unlock();
+
+        for (auto& promise : space) {
+          promise.SetWith([]() {});
+        }
+
+        bool more = sink_->OnBatch(batch_);
+        batch_.clear();
+
+        lock_.Lock();
+        if (!more) {
+          cancelled_ = true;
+          buffer_.clear();
+          space = std::move(space_);
+          StreamSinkPtr<T> sink(std::move(sink_));
+          lock_.Unlock();
+
+          FailWriters(space);
+          return;
+        }
+
+        continue;
+      }
+
+      if (end_ && !ended_) {
+        ended_ = true;
+        Try<void> end(std::move(end_.Value()));
+        StreamSinkPtr<T> sink(std::move(sink_));
+        lock_.Unlock();
+
+        sink->OnEnd(std::move(end));
+        return;
+      }
+
+      delivering_ = false;
+      lock_.Unlock();
+      return;
+    }
+  }
+
+  SpinLock<> lock_;
+  std::vector<T> buffer_;
+  // Owned by the deliverer; keeps its capacity from one batch to the next.
+  std::vector<T> batch_;
+  std::vector<Promise<void>> space_;
+  const size_t capacity_;
+  StreamSinkPtr<T> sink_;
+  Executor* executor_;
+  Option<Try<void>> end_;
+  bool delivering_;
+  bool cancelled_;
+  bool ended_;
+  std::atomic<unsigned int> refs_;
+};  // class StreamState
+
+// The reader's reference, until the sink is attached.
+template <class T>
+class StreamReader
+{
+ public:
+  explicit StreamReader(StreamState<T>* state) : state_(state)
+  {
+  }
+
+  StreamReader(StreamReader&& other) noexcept : state_(other.state_)
+  {
+    other.state_ = nullptr;
+  }
+
+  StreamReader(const StreamReader&) = delete;
+  StreamReader& operator=(const StreamReader&) = delete;
+
+  ~StreamReader()
+  {
+    if (state_) {
+      state_->Cancel();
+      state_->Release();
+    }
+  }
+
+  void Attach(StreamSinkPtr<T>&& sink, Executor* executor)
+  {
+    assert(state_);
+
+    state_->Attach(std::move(sink), executor);
+    state_->Release();
+    state_ = nullptr;
+  }
+
+ private:
+  StreamState<T>* state_;
+};  // class StreamReader
+
+template <class T, class U, class F>
+class MapSink : public StreamSink<T>
+{
+ public:
+  MapSink(F&& func, StreamSinkPtr<U>&& next)
+      : func_(std::move(func)), next_(std::move(next))
+  {
+  }
+
+  bool OnBatch(std::vector<T>& batch) override
+  {
+    out_.reserve(batch.size());
+    for (T& value : batch) {
+      out_.push_back(func_(std::move(value)));
+    }
+
+    bool more = next_->OnBatch(out_);
+    out_.clear();
+    return more;
+  }
+
+  void OnEnd(Try<void>&& end) override
+  {
+    next_->OnEnd(std::move(end));
+  }
+
+ private:
+  F func_;
+  StreamSinkPtr<U> next_;
+  std::vector<U> out_;
+};  // class MapSink
+
+template <class T, class F>
+class FilterSink : public StreamSink<T>
+{
+ public:
+  FilterSink(F&& func, StreamSinkPtr<T>&& next)
+      : func_(std::move(func)), next_(std::move(next))
+  {
+  }
+
+  bool OnBatch(std::vector<T>& batch) override
+  {
+    batch.erase(std::remove_if(batch.begin(), batch.end(),
+                               [this](T& value) { return !func_(value); }),
+                batch.end());
+
+    return batch.empty() || next_->OnBatch(batch);
+  }
+
+  void OnEnd(Try<void>&& end) override
+  {
+    next_->OnEnd(std::move(end));
+  }
+
+ private:
+  F func_;
+  StreamSinkPtr<T> next_;
+};  // class FilterSink
+
+template <class T>
+class TakeSink : public StreamSink<T>
+{
+ public:
+  TakeSink(size_t n, StreamSinkPtr<T>&& next)
+      : remaining_(n), next_(std::move(next))
+  {
+  }
+
+  bool OnBatch(std::vector<T>& batch) override
+  {
+    if (batch.size() < remaining_) {
+      remaining_ -= batch.size();
+      return next_->OnBatch(batch);
+    }
+
+    batch.resize(remaining_);
+    remaining_ = 0;
+
+    if (!batch.empty()) {
+      next_->OnBatch(batch);
+    }
+
+    next_->OnEnd(Try<void>());
+    return false;
+  }
+
+  void OnEnd(Try<void>&& end) override
+  {
+    next_->OnEnd(std::move(end));
+  }
+
+ private:
+  size_t remaining_;
+  StreamSinkPtr<T> next_;
+};  // class TakeSink
+
+template <class T>
+class BatchSink : public StreamSink<T>
+{
+ public:
+  BatchSink(size_t n, StreamSinkPtr<std::vector<T>>&& next)
+      : n_(n), next_(std::move(next))
+  {
+  }
+
+  bool OnBatch(std::vector<T>& batch) override
+  {
+    for (T& value : batch) {
+      pending_.push_back(std::move(value));
+      if (pending_.size() == n_) {
+        out_.push_back(std::move(pending_));
+        pending_.clear();
+      }
+    }
+
+    if (out_.empty()) {
+      return true;
+    }
+
+    bool more = next_->OnBatch(out_);
+    out_.clear();
+    return more;
+  }
+
+  // A short last group still goes out, unless the stream failed.
+  void OnEnd(Try<void>&& end) override
+  {
+    if (end.HasValue() && !pending_.empty()) {
+      out_.push_back(std::move(pending_));
+      if (!next_->OnBatch(out_)) {
+        return;
+      }
+    }
+
+    next_->OnEnd(std::move(end));
+  }
+
+ private:
+  const size_t n_;
+  StreamSinkPtr<std::vector<T>> next_;
+  std::vector<T> pending_;
+  std::vector<std::vector<T>> out_;
+};  // class BatchSink
+
+// Calls `func` with each batch and fulfils `promise` with the end.
+template <class T, class F>
+class ForEachBatchSink : public StreamSink<T>
+{
+ public:
+  ForEachBatchSink(F&& func, Promise<void>&& promise)
+      : func_(std::move(func)), promise_(std::move(promise))
+  {
+  }
+
+  bool OnBatch(std::vector<T>& batch) override
+  {
+    func_(batch);
+    return true;
+  }
+
+  void OnEnd(Try<void>&& end) override
+  {
+    if (end.HasError()) {
+      promise_.SetError(std::move(end.GetError()));
+    } else {
+      promise_.SetWith([]() {});
+    }
+  }
+
+ private:
+  F func_;
+  Promise<void> promise_;
+};  // class ForEachBatchSink
+
+}  // namespace detail
+
+// The producer end of a stream.
+//
+//   StreamWriter<Row> writer;
+//   Stream<Row> rows = writer.GetStream();
+//   ...
+//   writer.Write(row).Then([]() { /* room for more */ });
+//   writer.Close();
+template <class T>
+class StreamWriter
+{
+ public:
+  explicit StreamWriter(size_t capacity = kDefaultStreamCapacity)
+      : state_(new detail::StreamState<T>(capacity)), retrieved_(false)
+  {
+  }
+
+  StreamWriter(StreamWriter&& other) noexcept
+      : state_(other.state_), retrieved_(other.retrieved_)
+  {
+    other.state_ = nullptr;
+  }
+
+  StreamWriter& operator=(StreamWriter&& other) noexcept
+  {
+    std::swap(state_, other.state_);
+    std::swap(retrieved_, other.retrieved_);
+    return *this;
+  }
+
+  StreamWriter(const StreamWriter&) = delete;
+  StreamWriter& operator=(const StreamWriter&) = delete;
+
+  // Ends the stream with a `kBrokenPromise` error unless it was closed.
+  ~StreamWriter()
+  {
+    if (state_) {
+      if (!retrieved_) {
+        state_->Cancel();
+        state_->Release();
+      }
+
+      state_->Close(Try<void>(Error(ErrorCode(kBrokenPromise))));
+      state_->Release();
+    }
+  }
+
+  // Can only be called once.
+  Stream<T> GetStream()
+  {
+    assert(state_ && !retrieved_);
+
+    retrieved_ = true;
+    return Stream<T>(detail::StreamReader<T>(state_));
+  }
+
+  // Both forms return a future that is ready while the stream has room,
+  // and otherwise completes once the consumer catches up. Writers that wait
+  // for it keep at most the capacity buffered. It fails, and the element is
+  // dropped, once the consumer has stopped (see `Take`, `IsCancelled`).
+  Future<void> Write(T value)
+  {
+    assert(state_);
+    return state_->Write(nullptr, &value);
+  }
+
+  // Adds `batch` as a whole: the consumer gets it in one delivery.
+  Future<void> Write(std::vector<T> batch)
+  {
+    assert(state_);
+    return state_->Write(&batch, nullptr);
+  }
+
+  void Close()
+  {
+    assert(state_);
+    state_->Close(Try<void>());
+  }
+
+  void Fail(Error error)
+  {
+    assert(state_);
+    state_->Close(Try<void>(std::move(error)));
+  }
+
+  // Whether the consumer has stopped listening.
+  bool IsCancelled()
+  {
+    assert(state_);
+    return state_->IsCancelled();
+  }
+
+ private:
+  detail::StreamState<T>* state_;
+  bool retrieved_;
+};  // class StreamWriter
+
+// The consumer end of a stream. Every operation below consumes the stream;
+// the combinators return a new one, and nothing flows until a `ForEach` or
+// `ForEachBatch` at the end of the chain attaches. Until then the writer's
+// elements wait, within its capacity. Dropping a stream stops the writer.
+template <class T>
+class Stream
+{
+ public:
+  typedef T value_type;
+
+  Stream(Stream&&) = default;
+  Stream& operator=(Stream&&) = default;
+
+  Stream(const Stream&) = delete;
+  Stream& operator=(const Stream&) = delete;
+
+  // Delivers on `executor` instead of on the writing thread. A delivery
+  // takes everything written since the previous one.
+  Stream& Via(Executor* executor)
+  {
+    executor_ = executor;
+    return *this;
+  }
+
+  // `func(std::vector<T>&)` for each delivery. The returned future
+  // completes with the end of the stream.
+  template <class F>
+  Future<void> ForEachBatch(F&& func)
+  {
+    typedef typename std::decay<F>::type Func;
+
+    Promise<void> promise;
+    Future<void> f = promise.GetFuture();
+
+    Attach(detail::StreamSinkPtr<T>(new detail::ForEachBatchSink<T, Func>(
+        std::forward<F>(func), std::move(promise))));
+
+    return f;
+  }
+
+  // `func(T&&)` for each element.
+  template <class F>
+  Future<void> ForEach(F&& func)
+  {
+    return ForEachBatch(
+        [funcm = std::forward<F>(func)](std::vector<T>& batch) mutable {
+          for (T& value : batch) {
+            funcm(std::move(value));
+          }
+        });
+  }
+
+  // `func(T&&)` returns the new element.
+  template <class F,
+            class U = typename std::decay<
+                decltype(std::declval<F&>()(std::declval<T&&>()))>::type>
+  Stream<U> Map(F&& func)
+  {
+    typedef typename std::decay<F>::type Func;
+
+    return Then<U>([funcm = Func(std::forward<F>(func))](
+        detail::StreamSinkPtr<U>&& next) mutable {
+      return detail::StreamSinkPtr<T>(
+          new detail::MapSink<T, U, Func>(std::move(funcm), std::move(next)));
+    });
+  }
+
+  // Keeps the elements for which `func(const T&)` is true.
+  template <class F>
+  Stream<T> Filter(F&& func)
+  {
+    typedef typename std::decay<F>::type Func;
+
+    return Then<T>([funcm = Func(std::forward<F>(func))](
+        detail::StreamSinkPtr<T>&& next) mutable {
+      return detail::StreamSinkPtr<T>(
+          new detail::FilterSink<T, Func>(std::move(funcm), std::move(next)));
+    });
+  }
+
+  // The first `n` elements; the writer is stopped after that.
+  Stream<T> Take(size_t n)
+  {
+    return Then<T>([n](detail::StreamSinkPtr<T>&& next) {
+      return detail::StreamSinkPtr<T>(
+          new detail::TakeSink<T>(n, std::move(next)));
+    });
+  }
+
+  // Groups of `n` elements, the last one possibly shorter.
+  Stream<std::vector<T>> Batch(size_t n)
+  {
+    assert(n > 0);
+
+    return Then<std::vector<T>>(
+        [n](detail::StreamSinkPtr<std::vector<T>>&& next) {
+          return detail::StreamSinkPtr<T>(
+              new detail::BatchSink<T>(n, std::move(next)));
+        });
+  }
+
+ private:
+  template <class>
+  friend class Stream;
+  friend class StreamWriter<T>;
+
+  typedef InlineFunction<void(detail::StreamSinkPtr<T>&&, Executor*)>
+      AttachFunction;
+
+  explicit Stream(detail::StreamReader<T>&& reader)
+      : attach_([readerm = std::move(reader)](
+            detail::StreamSinkPtr<T>&& sink, Executor* executor) mutable {
+          readerm.Attach(std::move(sink), executor);
+        }),
+        executor_(nullptr)
+  {
+  }
+
+  Stream(AttachFunction&& attach, Executor* executor)
+      : attach_(std::move(attach)), executor_(executor)
+  {
+  }
+
+  void Attach(detail::StreamSinkPtr<T>&& sink)
+  {
+    assert(attach_);
+
+    AttachFunction attach(std::move(attach_));
+    attach(std::move(sink), executor_);
+  }
+
+  // A stream of `U` whose sinks are wrapped by `wrap` into sinks of ours.
+  template <class U, class Wrap>
+  Stream<U> Then(Wrap&& wrap)
+  {
+    assert(attach_);
+
+    typedef typename Stream<U>::AttachFunction Attach;
+
+    return Stream<U>(
+        Attach([ attach = std::move(attach_), wrapm = std::move(wrap) ](
+            detail::StreamSinkPtr<U> && next, Executor * executor) mutable {
+          attach(wrapm(std::move(next)), executor);
+        }),
+        executor_);
+  }
+
+  AttachFunction attach_;
+  Executor* executor_;
+};  // class Stream
+
+}  // namespace dien
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ *  File:   thread_pool_executor.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Executors backed by dedicated threads sharing one queue.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "executor.hpp"
+
+namespace dien
+{
+
+// A fixed number of threads taking functions from one FIFO queue. Functions
+// still queued when the executor is destroyed are run before it returns.
+class ThreadPoolExecutor : public Executor
+{
+ public:
+  explicit ThreadPoolExecutor(size_t threads) : stopping_(false)
+  {
+    for (size_t i = 0; i < threads; i++) {
+      threads_.emplace_back([this]() { Run(); });
+    }
+  }
+
+  ~ThreadPoolExecutor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+
+    cv_.notify_all();
+
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+  ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+  void Add(Func func) override
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(func));
+    }
+
+    cv_.notify_one();
+  }
+
+  size_t NumThreads() const
+  {
+    return threads_.size();
+  }
+
+ private:
+  void Run()
+  {
+    for (;;) {
+      Func func;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+
+        if (queue_.empty()) {
+          return;
+        }
+
+        func = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      func();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Func> queue_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};  // class ThreadPoolExecutor
+
+// One thread; functions run in the order they were added.
+class SingleThreadExecutor : public ThreadPoolExecutor
+{
+ public:
+  SingleThreadExecutor() : ThreadPoolExecutor(1)
+  {
+  }
+};  // class SingleThreadExecutor
+
+}  // namespace dien
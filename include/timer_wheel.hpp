@@ -0,0 +1,427 @@
+/******************************************************************************
+ *
+ *  File:   timer_wheel.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Hierarchical timing wheel serviced by a single thread. Backs
+ *              `Sleep` and `Future::Within`.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "allocator.hpp"
+#include "executor.hpp"
+#include "park.hpp"
+
+namespace dien
+{
+
+class TimerWheel;
+
+namespace detail
+{
+
+enum TimerState : uint32_t {
+  kTimerPending,
+  kTimerFired,
+  kTimerCancelled
+};
+
+struct TimerNode
+{
+  TimerNode(Func&& f, uint64_t tick)
+      : func(std::move(f)), expires(tick), state(kTimerPending), refs(2)
+  {
+  }
+
+  static void* operator new(size_t size)
+  {
+    return AllocateBlock(size);
+  }
+
+  static void operator delete(void* p, size_t size)
+  {
+    DeallocateBlock(p, size);
+  }
+
+  void Release()
+  {
+    if (refs.fetch_sub(1) == 1) {
+      delete this;
+    }
+  }
+
+  Func func;
+  uint64_t expires;
+
+  // Slot list, owned by the wheel thread.
+  TimerNode* next = nullptr;
+
+  // Link in the lock-free inbox of newly added timers.
+  TimerNode* inbox_next = nullptr;
+
+  std::atomic<uint32_t> state;
+  // One reference for the wheel, one for the `Timer` handle.
+  std::atomic<uint32_t> refs;
+};
+
+}  // namespace detail
+
+// Handle to a scheduled function. Dropping the handle does not cancel it.
+class Timer
+{
+ public:
+  Timer() : node_(nullptr)
+  {
+  }
+
+  ~Timer()
+  {
+    if (node_) node_->Release();
+  }
+
+  Timer(Timer&& other) noexcept : node_(other.node_)
+  {
+    other.node_ = nullptr;
+  }
+
+  Timer& operator=(Timer&& other) noexcept
+  {
+    std::swap(node_, other.node_);
+    return *this;
+  }
+
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+
+  // Cancels the timer if it has not fired yet, destroying the function on
+  // the calling thread. Returns false if the function already ran (or is
+  // running). The wheel reclaims the node itself when its slot comes round.
+  bool Cancel()
+  {
+    if (!node_) return false;
+
+    uint32_t state = detail::kTimerPending;
+    if (!node_->state.compare_exchange_strong(state,
+                                              detail::kTimerCancelled)) {
+      return false;
+    }
+
+    node_->func = nullptr;
+    return true;
+  }
+
+ private:
+  friend class TimerWheel;
+
+  explicit Timer(detail::TimerNode* node) : node_(node)
+  {
+  }
+
+  detail::TimerNode* node_;
+};  // class Timer
+
+// Classic hierarchical wheel with a 1ms tick: 256 slots for the next 256
+// ticks, then three levels of 64 slots, each slot spanning a whole turn of
+// the level below. Longer delays are parked in the top level and re-filed
+// as it cascades.
+//
+// `Add` is O(1) and lock-free: timers are pushed onto an inbox that the
+// wheel thread drains before each tick. The thread sleeps until the next
+// non-empty level-0 slot (or the next cascade) and is only woken by `Add`
+// when the new timer is due before that.
+//
+// Functions run on the wheel thread and so should be short; hand anything
+// heavier to an `Executor`. Timers still pending when the wheel is destroyed
+// are dropped without running.
+class TimerWheel
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  TimerWheel()
+      : start_(Clock::now()),
+        next_tick_(0),
+        filed_(0),
+        inbox_(nullptr),
+        wake_tick_(0),
+        epoch_(0),
+        stopping_(false)
+  {
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  ~TimerWheel()
+  {
+    stopping_.store(true);
+    epoch_.fetch_add(1);
+    UnparkOne(epoch_);
+    thread_.join();
+
+    for (detail::TimerNode* node = inbox_.exchange(nullptr); node;) {
+      detail::TimerNode* next = node->inbox_next;
+      Discard(node);
+      node = next;
+    }
+
+    for (auto& level : wheel_) {
+      for (detail::TimerNode* node : level) {
+        while (node) {
+          detail::TimerNode* next = node->next;
+          Discard(node);
+          node = next;
+        }
+      }
+    }
+  }
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  static TimerWheel& Instance()
+  {
+    static TimerWheel instance;
+    return instance;
+  }
+
+  template <class Rep, class Period>
+  Timer Add(const std::chrono::duration<Rep, Period>& delay, Func func)
+  {
+    return AddAt(Clock::now() +
+                     std::chrono::duration_cast<Clock::duration>(delay),
+                 std::move(func));
+  }
+
+  Timer AddAt(Clock::time_point deadline, Func func)
+  {
+    detail::TimerNode* node =
+        new detail::TimerNode(std::move(func), TickOf(deadline));
+
+    detail::TimerNode* head = inbox_.load(std::memory_order_relaxed);
+    do {
+      node->inbox_next = head;
+    } while (!inbox_.compare_exchange_weak(head, node));
+
+    // The wheel thread publishes the tick it plans to sleep until (0 while
+    // awake). Claim the wake-up only if this timer is due earlier.
+    uint64_t wake = wake_tick_.load();
+    while (node->expires < wake) {
+      if (wake_tick_.compare_exchange_weak(wake, 0)) {
+        epoch_.fetch_add(1);
+        UnparkOne(epoch_);
+        break;
+      }
+    }
+
+    return Timer(node);
+  }
+
+ private:
+  static const int kLevels = 4;
+  static const int kLevel0Bits = 8;
+  static const int kLevelBits = 6;
+  static const uint64_t kLevel0Slots = 1 << kLevel0Bits;
+  static const uint64_t kLevelSlots = 1 << kLevelBits;
+  static const uint64_t kMaxDelta =
+      (uint64_t(1) << (kLevel0Bits + (kLevels - 1) * kLevelBits)) - 1;
+
+  static int Shift(int level)
+  {
+    return level == 0 ? 0 : kLevel0Bits + (level - 1) * kLevelBits;
+  }
+
+  static uint64_t SlotMask(int level)
+  {
+    return level == 0 ? kLevel0Slots - 1 : kLevelSlots - 1;
+  }
+
+  // Rounds up, so a timer never fires early.
+  uint64_t TickOf(Clock::time_point when) const
+  {
+    if (when <= start_) return 0;
+
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      when - start_ + std::chrono::milliseconds(1) -
+                      Clock::duration(1))
+                      .count();
+    return static_cast<uint64_t>(millis);
+  }
+
+  uint64_t Now() const
+  {
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      Clock::now() - start_)
+                      .count();
+    return static_cast<uint64_t>(millis);
+  }
+
+  // Wheel thread only.
+  void Insert(detail::TimerNode* node)
+  {
+    uint64_t expires = node->expires < next_tick_ ? next_tick_ : node->expires;
+    uint64_t delta = expires - next_tick_;
+
+    if (delta > kMaxDelta) {
+      // Re-filed with its real expiry when the top level cascades.
+      delta = kMaxDelta;
+      expires = next_tick_ + kMaxDelta;
+    }
+
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (uint64_t(1) << Shift(level + 1))) {
+      level++;
+    }
+
+    detail::TimerNode*& slot =
+        wheel_[level][(expires >> Shift(level)) & SlotMask(level)];
+    node->next = slot;
+    slot = node;
+  }
+
+  // Moves every timer in the level's current slot down the hierarchy.
+  // Returns the slot index so the caller knows whether this level wrapped.
+  uint64_t Cascade(int level)
+  {
+    uint64_t index = (next_tick_ >> Shift(level)) & SlotMask(level);
+    detail::TimerNode* node = wheel_[level][index];
+    wheel_[level][index] = nullptr;
+
+    while (node) {
+      detail::TimerNode* next = node->next;
+      if (node->state.load(std::memory_order_relaxed) ==
+          detail::kTimerCancelled) {
+        filed_--;
+        node->Release();
+      } else {
+        Insert(node);
+      }
+      node = next;
+    }
+
+    return index;
+  }
+
+  void Tick()
+  {
+    uint64_t index = next_tick_ & SlotMask(0);
+    if (index == 0) {
+      for (int level = 1; level < kLevels && Cascade(level) == 0; level++) {
+      }
+    }
+
+    detail::TimerNode* node = wheel_[0][index];
+    wheel_[0][index] = nullptr;
+
+    while (node) {
+      detail::TimerNode* next = node->next;
+
+      uint32_t state = detail::kTimerPending;
+      if (node->expires > next_tick_) {
+        // Clamped by `Insert`; not due yet.
+        Insert(node);
+      } else {
+        if (node->state.compare_exchange_strong(state, detail::kTimerFired)) {
+          node->func();
+          node->func = nullptr;
+        }
+        filed_--;
+        node->Release();
+      }
+
+      node = next;
+    }
+
+    next_tick_++;
+  }
+
+  // First tick worth waking up for: the next non-empty level-0 slot, or the
+  // next cascade into level 0 (which may be `next_tick_` itself).
+  uint64_t NextWakeTick() const
+  {
+    uint64_t boundary = (next_tick_ + SlotMask(0)) & ~SlotMask(0);
+    for (uint64_t tick = next_tick_; tick < boundary; tick++) {
+      if (wheel_[0][tick & SlotMask(0)]) {
+        return tick;
+      }
+    }
+
+    return boundary;
+  }
+
+  void DrainInbox()
+  {
+    detail::TimerNode* node = inbox_.exchange(nullptr);
+    while (node) {
+      detail::TimerNode* next = node->inbox_next;
+      filed_++;
+      Insert(node);
+      node = next;
+    }
+  }
+
+  void Run()
+  {
+    while (!stopping_.load()) {
+      DrainInbox();
+
+      uint64_t now = Now();
+      if (filed_ == 0) {
+        // Nothing to tick over; an empty wheel can jump straight to now.
+        next_tick_ = std::max(next_tick_, now + 1);
+      }
+
+      while (next_tick_ <= now) {
+        Tick();
+        DrainInbox();
+      }
+
+      uint64_t wake = filed_ == 0 ? UINT64_MAX : NextWakeTick();
+      uint32_t epoch = epoch_.load();
+      wake_tick_.store(wake);
+
+      // Pairs with the inbox push in `AddAt`: either we see the new timer
+      // here or the adder sees `wake_tick_` and wakes us.
+      if (inbox_.load() == nullptr && !stopping_.load()) {
+        if (wake == UINT64_MAX) {
+          Park(epoch_, epoch);
+        } else {
+          ParkUntil(epoch_, epoch, start_ + std::chrono::milliseconds(wake));
+        }
+      }
+
+      wake_tick_.store(0);
+    }
+  }
+
+  static void Discard(detail::TimerNode* node)
+  {
+    uint32_t state = detail::kTimerPending;
+    if (node->state.compare_exchange_strong(state, detail::kTimerCancelled)) {
+      node->func = nullptr;
+    }
+    node->Release();
+  }
+
+  const Clock::time_point start_;
+
+  // Wheel thread only.
+  uint64_t next_tick_;
+  size_t filed_;
+  detail::TimerNode* wheel_[kLevels][kLevel0Slots] = {};
+
+  std::atomic<detail::TimerNode*> inbox_;
+  std::atomic<uint64_t> wake_tick_;
+  std::atomic<uint32_t> epoch_;
+  std::atomic<bool> stopping_;
+
+  std::thread thread_;
+};  // class TimerWheel
+
+}  // namespace dien
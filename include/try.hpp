@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cassert>
 #include <type_traits>
 #include <exception>
 #include <algorithm>
@@ -106,6 +107,9 @@ private:
   };
 };
 
+// Holds nothing but an `Error`, whose chain pointer doubles as the
+// discriminant: an empty error stack means success. `Try<void>` is therefore
+// a single pointer.
 template <>
 class Try<void>
 {
@@ -116,75 +120,30 @@ public:
   typedef void element_type;
 
   // Construct a Try holding a successful and void result
-  Try() : hasValue_(true) {}
+  Try() : e_(Error::ErrorStack()) {}
 
-  explicit Try(Error e) : hasValue_(false), e_(std::move(e)) {}
-
-  // Copy assigner
-  Try& operator=(const Try<void>& t)
+  // An empty `e` would read as success, so it is reported as `kFailed`.
+  explicit Try(Error e) : e_(std::move(e))
   {
-    if (&t != this) {
-      this->~Try();
-
-      if (t.HasError()) {
-        new (&e_) Error(t.e_);
-      } else {
-        hasValue_ = true;
-      }
+    if (e_.error_stack.empty()) {
+      e_.Stack(ErrorCode(kFailed));
     }
-
-    return *this;
   }
 
-  // Copy constructor
-  Try(const Try<void>& t)
-  {
-    if (t.HasError()) {
-      new (&e_) Error(t.e_);
-    } else {
-      hasValue_ = true;
-    }
-  }
+  Try(const Try<void>& t) = default;
+  Try& operator=(const Try<void>& t) = default;
 
-  Try(Try<void>&& t) noexcept
-  {
-    if (t.HasError()) {
-      new (&e_) Error(std::move(t.e_));
-    } else {
-      hasValue_ = true;
-    }
-  }
-
-  Try& operator=(Try<void>&& t) noexcept
-  {
-    if (this == &t) {
-      return *this;
-    }
-
-    this->~Try();
-
-    if (t.HasError()) {
-      new (&e_) Error(std::move(t.e_));
-    }
-
-    return *this;
-  }
-
-  ~Try()
-  {
-    if (HasError()) {
-      e_.Clear();
-    }
-  }
+  Try(Try<void>&& t) noexcept = default;
+  Try& operator=(Try<void>&& t) noexcept = default;
 
   // If the Try contains an exception, throws it
-  void Value() const { assert(hasValue_); }
+  void Value() const { assert(HasValue()); }
 
   void operator*() const { return Value(); }
 
-  bool HasValue() const { return hasValue_; }
+  bool HasValue() const { return e_.error_stack.empty(); }
 
-  bool HasError() const { return !hasValue_; }
+  bool HasError() const { return !HasValue(); }
 
   Error& GetError()
   {
@@ -224,13 +183,16 @@ public:
   }
 
 private:
-  bool hasValue_;
-  union
-  {
-    Error e_;
-  };
+  Error e_;
 }; // class Try
 
+// The error side of every `Try` is one pointer to an out-of-line chain, so a
+// `Try` of a small value fits in two words.
+static_assert(sizeof(Try<void>) == sizeof(void*),
+              "Try<void> should be a single pointer");
+static_assert(sizeof(Try<int>) <= 16, "Try<int> should fit in 16 bytes");
+static_assert(sizeof(Try<void*>) <= 16, "Try<T*> should fit in 16 bytes");
+
 /*
  * @param f a function to execute and capture the result of (value or exception)
  *
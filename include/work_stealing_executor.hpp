@@ -0,0 +1,225 @@
+/******************************************************************************
+ *
+ *  File:   work_stealing_executor.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Fixed size thread pool with per-worker Chase-Lev deques and
+ *              random-victim stealing.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "allocator.hpp"
+#include "chase_lev_deque.hpp"
+#include "executor.hpp"
+#include "park.hpp"
+
+namespace dien
+{
+
+// Functions added from one of the pool's own workers go onto that worker's
+// deque and are popped LIFO, so a continuation usually runs right after the
+// task that produced its input, on the same core. Functions added from
+// outside go through a shared injection queue. Idle workers steal from a
+// random victim, then check the injection queue, then park.
+//
+// Functions still queued when the executor is destroyed are run before it
+// returns.
+class WorkStealingExecutor : public Executor
+{
+ public:
+  explicit WorkStealingExecutor(size_t threads)
+      : injected_(0), stopping_(false), sleepers_(0), epoch_(0)
+  {
+    for (size_t i = 0; i < threads; i++) {
+      workers_.emplace_back(new Worker(i));
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+      workers_[i]->thread = std::thread([this, i]() { Run(*workers_[i]); });
+    }
+  }
+
+  ~WorkStealingExecutor()
+  {
+    stopping_.store(true);
+    Wake(true);
+
+    for (auto& worker : workers_) {
+      worker->thread.join();
+    }
+  }
+
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  void Add(Func func) override
+  {
+    Task* task = new Task(std::move(func));
+
+    Worker* worker = CurrentWorker();
+    if (worker && worker->executor == this) {
+      worker->deque.Push(task);
+    } else {
+      std::lock_guard<std::mutex> lock(injection_mutex_);
+      injection_.push_back(task);
+      injected_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in `Run` before a worker parks.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) > 0) {
+      Wake(false);
+    }
+  }
+
+  size_t NumThreads() const
+  {
+    return workers_.size();
+  }
+
+ private:
+  struct Task
+  {
+    explicit Task(Func&& f) : func(std::move(f))
+    {
+    }
+
+    static void* operator new(size_t size)
+    {
+      return AllocateBlock(size);
+    }
+
+    static void operator delete(void* p, size_t size)
+    {
+      DeallocateBlock(p, size);
+    }
+
+    Func func;
+  };
+
+  struct Worker
+  {
+    explicit Worker(size_t i) : index(i), executor(nullptr), seed(i * 2 + 1)
+    {
+    }
+
+    size_t index;
+    WorkStealingExecutor* executor;
+    uint32_t seed;
+    ChaseLevDeque<Task*> deque;
+    std::thread thread;
+  };
+
+  static Worker*& CurrentWorker()
+  {
+    static thread_local Worker* current = nullptr;
+    return current;
+  }
+
+  static uint32_t NextRandom(uint32_t& state)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  Task* FindTask(Worker& self)
+  {
+    Task* task = nullptr;
+
+    if (self.deque.Pop(task)) {
+      return task;
+    }
+
+    size_t count = workers_.size();
+    size_t start = NextRandom(self.seed) % count;
+    for (size_t i = 0; i < count; i++) {
+      Worker& victim = *workers_[(start + i) % count];
+      if (&victim != &self && victim.deque.Steal(task)) {
+        return task;
+      }
+    }
+
+    if (injected_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(injection_mutex_);
+      if (!injection_.empty()) {
+        task = injection_.front();
+        injection_.pop_front();
+        injected_.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+      }
+    }
+
+    return nullptr;
+  }
+
+  void Run(Worker& self)
+  {
+    self.executor = this;
+    CurrentWorker() = &self;
+
+    for (;;) {
+      Task* task = FindTask(self);
+
+      if (!task) {
+        uint32_t epoch = epoch_.load();
+        sleepers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        task = FindTask(self);
+        if (!task) {
+          if (stopping_.load()) {
+            sleepers_.fetch_sub(1);
+            break;
+          }
+
+          Park(epoch_, epoch);
+        }
+
+        sleepers_.fetch_sub(1);
+      }
+
+      if (task) {
+        task->func();
+        delete task;
+      }
+    }
+
+    CurrentWorker() = nullptr;
+  }
+
+  void Wake(bool all)
+  {
+    epoch_.fetch_add(1);
+
+    if (all) {
+      UnparkAll(epoch_);
+    } else {
+      UnparkOne(epoch_);
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex injection_mutex_;
+  std::deque<Task*> injection_;
+  // Lets workers skip the injection lock while the queue is empty.
+  std::atomic<size_t> injected_;
+
+  std::atomic<bool> stopping_;
+  std::atomic<uint32_t> sleepers_;
+  std::atomic<uint32_t> epoch_;
+};  // class WorkStealingExecutor
+
+}  // namespace dien
@@ -0,0 +1,42 @@
+/******************************************************************************
+ *
+ *  File:   allocation_counter.hpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Counts global `operator new` calls made by the current
+ *              thread. The counting `operator new` lives in
+ *              allocation_counter.cpp.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+namespace dien
+{
+namespace test
+{
+
+// Number of `operator new` calls made by this thread so far.
+size_t ThreadAllocations();
+
+// Counts the allocations made by this thread since construction.
+class AllocationCounter
+{
+ public:
+  AllocationCounter() : start_(ThreadAllocations())
+  {
+  }
+
+  size_t Count() const
+  {
+    return ThreadAllocations() - start_;
+  }
+
+ private:
+  size_t start_;
+};  // class AllocationCounter
+
+}  // namespace test
+}  // namespace dien
@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ *  File:   allocation_counter.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Counting replacement of the global `operator new`.
+ *
+ ******************************************************************************/
+
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.hpp"
+
+namespace
+{
+
+thread_local size_t thread_allocations = 0;
+
+}  // namespace
+
+namespace dien
+{
+namespace test
+{
+
+size_t ThreadAllocations()
+{
+  return thread_allocations;
+}
+
+}  // namespace test
+}  // namespace dien
+
+void* operator new(size_t size)
+{
+  thread_allocations++;
+
+  void* p = std::malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ *  File:   allocator_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `BlockAllocator` and the per-thread pools.
+ *
+ ******************************************************************************/
+
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "allocation_counter.hpp"
+#include "allocator.hpp"
+#include "future.hpp"
+
+using namespace dien;
+using namespace dien::test;
+
+namespace
+{
+
+class CountingAllocator : public BlockAllocator
+{
+ public:
+  void* Allocate(size_t size) override
+  {
+    allocations++;
+    return MallocAllocator::Instance().Allocate(size);
+  }
+
+  void Deallocate(void* block, size_t size) override
+  {
+    deallocations++;
+    MallocAllocator::Instance().Deallocate(block, size);
+  }
+
+  int allocations = 0;
+  int deallocations = 0;
+};
+
+}  // namespace
+
+TEST(AllocatorTests, PoolReusesBlocks)
+{
+  void* first = AllocateBlock(64);
+  DeallocateBlock(first, 64);
+
+  AllocationCounter counter;
+  void* second = AllocateBlock(64);
+
+  ASSERT_EQ(first, second);
+  ASSERT_EQ(counter.Count(), 0u);
+
+  DeallocateBlock(second, 64);
+}
+
+TEST(AllocatorTests, RemoteFreeReturnsToOwner)
+{
+  void* block = AllocateBlock(96);
+
+  std::thread other([block]() { DeallocateBlock(block, 96); });
+  other.join();
+
+  AllocationCounter counter;
+  void* again = AllocateBlock(96);
+
+  ASSERT_EQ(again, block);
+  ASSERT_EQ(counter.Count(), 0u);
+
+  DeallocateBlock(again, 96);
+}
+
+TEST(AllocatorTests, BlocksOutliveOwnerThread)
+{
+  std::vector<void*> blocks;
+
+  std::thread owner([&blocks]() {
+    for (int i = 0; i < 16; i++) {
+      blocks.push_back(AllocateBlock(48));
+    }
+  });
+  owner.join();
+
+  for (void* block : blocks) {
+    DeallocateBlock(block, 48);
+  }
+}
+
+TEST(AllocatorTests, HookAppliesToSharedData)
+{
+  CountingAllocator allocator;
+  BlockAllocator* previous = SetBlockAllocator(&allocator);
+
+  {
+    Promise<int> promise;
+    Future<int> f = promise.GetFuture();
+    promise.SetValue(1);
+    ASSERT_EQ(f.Value(), 1);
+  }
+
+  SetBlockAllocator(previous);
+
+  ASSERT_EQ(allocator.allocations, 1);
+  ASSERT_EQ(allocator.deallocations, 1);
+}
+
+TEST(AllocatorTests, HookSwapWhileBlocksAlive)
+{
+  CountingAllocator allocator;
+
+  {
+    BlockAllocator* previous = SetBlockAllocator(&allocator);
+    Promise<int> promise;
+    SetBlockAllocator(previous);
+
+    Future<int> f = promise.GetFuture();
+    promise.SetValue(1);
+  }
+
+  // Freed through the allocator that produced it, not the current hook.
+  ASSERT_EQ(allocator.allocations, 1);
+  ASSERT_EQ(allocator.deallocations, 1);
+}
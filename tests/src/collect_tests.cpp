@@ -0,0 +1,344 @@
+/******************************************************************************
+ *
+ *  File:   collect_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `CollectAll`, `CollectAny`, `CollectN`,
+ *              `Reduce` and `UnorderedReduce`.
+ *
+ ******************************************************************************/
+
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "allocation_counter.hpp"
+#include "collect.hpp"
+#include "thread_pool_executor.hpp"
+
+using namespace dien;
+using namespace dien::test;
+
+TEST(CollectTests, CollectAllKeepsInputOrder)
+{
+  std::vector<Promise<int>> promises(4);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::vector<Try<int>>> all =
+      CollectAll(futures.begin(), futures.end());
+
+  promises[2].SetValue(2);
+  promises[0].SetValue(0);
+  promises[3].SetError(Error("shard down"));
+  ASSERT_FALSE(all.IsReady());
+
+  promises[1].SetValue(1);
+  ASSERT_TRUE(all.IsReady());
+
+  std::vector<Try<int>>& results = all.Value();
+  ASSERT_EQ(results.size(), 4u);
+  ASSERT_EQ(results[0].Value(), 0);
+  ASSERT_EQ(results[1].Value(), 1);
+  ASSERT_EQ(results[2].Value(), 2);
+  ASSERT_TRUE(results[3].HasError());
+}
+
+TEST(CollectTests, CollectAllEmpty)
+{
+  std::vector<Future<int>> futures;
+
+  Future<std::vector<Try<int>>> all =
+      CollectAll(futures.begin(), futures.end());
+
+  ASSERT_TRUE(all.IsReady());
+  ASSERT_TRUE(all.Value().empty());
+}
+
+TEST(CollectTests, CollectAllAcrossThreads)
+{
+  const int kFutures = 1000;
+
+  std::vector<Promise<int>> promises(kFutures);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::vector<Try<int>>> all =
+      CollectAll(futures.begin(), futures.end());
+
+  {
+    ThreadPoolExecutor pool(4);
+    for (int i = 0; i < kFutures; i++) {
+      pool.Add([&promises, i]() { promises[i].SetValue(i); });
+    }
+  }
+
+  all.Wait();
+  for (int i = 0; i < kFutures; i++) {
+    ASSERT_EQ(all.Value()[i].Value(), i);
+  }
+}
+
+TEST(CollectTests, CollectAllVariadic)
+{
+  Promise<int> p1;
+  Promise<std::string> p2;
+  Promise<void> p3;
+
+  Future<std::tuple<Try<int>, Try<std::string>, Try<void>>> all =
+      CollectAll(p1.GetFuture(), p2.GetFuture(), p3.GetFuture());
+
+  p2.SetValue(std::string("two"));
+  p3.SetWith([]() {});
+  ASSERT_FALSE(all.IsReady());
+
+  p1.SetValue(1);
+  ASSERT_TRUE(all.IsReady());
+
+  ASSERT_EQ(std::get<0>(all.Value()).Value(), 1);
+  ASSERT_EQ(std::get<1>(all.Value()).Value(), "two");
+  ASSERT_TRUE(std::get<2>(all.Value()).HasValue());
+}
+
+TEST(CollectTests, CollectAny)
+{
+  std::vector<Promise<int>> promises(3);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::pair<size_t, Try<int>>> any =
+      CollectAny(futures.begin(), futures.end());
+  ASSERT_FALSE(any.IsReady());
+
+  promises[1].SetValue(10);
+  ASSERT_TRUE(any.IsReady());
+  ASSERT_EQ(any.Value().first, 1u);
+  ASSERT_EQ(any.Value().second.Value(), 10);
+
+  // Later completions are ignored.
+  promises[0].SetValue(0);
+  promises[2].SetValue(20);
+  ASSERT_EQ(any.Value().first, 1u);
+}
+
+TEST(CollectTests, CollectAnyEmptyFails)
+{
+  std::vector<Future<int>> futures;
+
+  ASSERT_TRUE(CollectAny(futures.begin(), futures.end()).HasError());
+}
+
+TEST(CollectTests, CollectN)
+{
+  std::vector<Promise<int>> promises(5);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::vector<std::pair<size_t, Try<int>>>> quorum =
+      CollectN(futures.begin(), futures.end(), 3);
+
+  promises[4].SetValue(4);
+  promises[1].SetValue(1);
+  ASSERT_FALSE(quorum.IsReady());
+
+  promises[3].SetValue(3);
+  ASSERT_TRUE(quorum.IsReady());
+
+  auto& results = quorum.Value();
+  ASSERT_EQ(results.size(), 3u);
+  ASSERT_EQ(results[0].first, 4u);
+  ASSERT_EQ(results[1].first, 1u);
+  ASSERT_EQ(results[2].first, 3u);
+  ASSERT_EQ(results[2].second.Value(), 3);
+
+  promises[0].SetValue(0);
+  promises[2].SetValue(2);
+  ASSERT_EQ(results.size(), 3u);
+}
+
+TEST(CollectTests, CollectNTooFewFails)
+{
+  std::vector<Promise<int>> promises(2);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  ASSERT_TRUE(CollectN(futures.begin(), futures.end(), 3).HasError());
+}
+
+TEST(CollectTests, ReduceFoldsInInputOrder)
+{
+  std::vector<Promise<int>> promises(4);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::string> r =
+      Reduce(futures.begin(), futures.end(), std::string(),
+             [](std::string&& s, int v) { return s + std::to_string(v); });
+
+  promises[2].SetValue(2);
+  promises[1].SetValue(1);
+  promises[3].SetValue(3);
+  ASSERT_FALSE(r.IsReady());
+
+  promises[0].SetValue(0);
+  ASSERT_EQ(r.Value(), "0123");
+}
+
+TEST(CollectTests, UnorderedReduceFoldsInCompletionOrder)
+{
+  std::vector<Promise<int>> promises(4);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::string> r =
+      UnorderedReduce(futures.begin(), futures.end(), std::string(),
+                      [](std::string&& s, int v) {
+                        return s + std::to_string(v);
+                      });
+
+  promises[2].SetValue(2);
+  promises[1].SetValue(1);
+  promises[3].SetValue(3);
+  promises[0].SetValue(0);
+  ASSERT_EQ(r.Value(), "2130");
+}
+
+TEST(CollectTests, ReduceFailsOnError)
+{
+  std::vector<Promise<int>> promises(3);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises) {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<int> r = UnorderedReduce(futures.begin(), futures.end(), 0,
+                                  [](int&& sum, int v) { return sum + v; });
+
+  promises[0].SetValue(1);
+  promises[1].SetError(Error("shard down"));
+  ASSERT_TRUE(r.HasError());
+
+  promises[2].SetValue(2);
+  ASSERT_TRUE(r.HasError());
+}
+
+TEST(CollectTests, ReduceEmpty)
+{
+  std::vector<Future<int>> futures;
+  Future<int> r = Reduce(futures.begin(), futures.end(), 7,
+                         [](int&& sum, int v) { return sum + v; });
+
+  ASSERT_EQ(r.Value(), 7);
+}
+
+// Nothing is allocated per input: the fold costs the same for 10 inputs as
+// for 1000.
+TEST(CollectTests, UnorderedReduceMemoryDoesNotGrow)
+{
+  size_t allocations[2];
+  int sizes[2] = {10, 1000};
+
+  for (int k = 0; k < 2; k++) {
+    std::vector<Promise<int>> promises(sizes[k]);
+    std::vector<Future<int>> futures;
+    for (auto& promise : promises) {
+      futures.push_back(promise.GetFuture());
+    }
+
+    BlockAllocator* previous =
+        SetBlockAllocator(&MallocAllocator::Instance());
+    AllocationCounter counter;
+
+    Future<long> r = UnorderedReduce(futures.begin(), futures.end(), 0L,
+                                     [](long&& sum, int v) { return sum + v; });
+    for (int i = 0; i < sizes[k]; i++) {
+      promises[i].SetValue(i);
+    }
+
+    allocations[k] = counter.Count();
+    SetBlockAllocator(previous);
+
+    ASSERT_EQ(r.Value(), static_cast<long>(sizes[k]) * (sizes[k] - 1) / 2);
+  }
+
+  ASSERT_EQ(allocations[0], allocations[1]);
+}
+
+TEST(CollectTests, ReduceAcrossThreads)
+{
+  const int kFutures = 10000;
+
+  std::vector<Promise<int>> ordered(kFutures);
+  std::vector<Promise<int>> unordered(kFutures);
+  std::vector<Future<int>> a;
+  std::vector<Future<int>> b;
+  for (int i = 0; i < kFutures; i++) {
+    a.push_back(ordered[i].GetFuture());
+    b.push_back(unordered[i].GetFuture());
+  }
+
+  int next = 0;
+  Future<bool> in_order = Reduce(a.begin(), a.end(), true,
+                                 [&next](bool&& ok, int v) {
+                                   return ok && v == next++;
+                                 });
+  Future<long> sum = UnorderedReduce(b.begin(), b.end(), 0L,
+                                     [](long&& s, int v) { return s + v; });
+
+  {
+    ThreadPoolExecutor pool(4);
+    for (int i = 0; i < kFutures; i++) {
+      pool.Add([&ordered, &unordered, i]() {
+        ordered[i].SetValue(i);
+        unordered[i].SetValue(i);
+      });
+    }
+  }
+
+  in_order.Wait();
+  sum.Wait();
+  ASSERT_TRUE(in_order.Value());
+  ASSERT_EQ(sum.Value(), static_cast<long>(kFutures) * (kFutures - 1) / 2);
+}
+
+// One arrival is stalled after storing its result but before announcing
+// it, while the other folds both results and fulfils the reduce. The
+// context must outlive the stalled arrival. It comes straight from malloc,
+// so that a sanitizer sees it freed.
+TEST(CollectTests, ReduceOutlivesStalledArrival)
+{
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+
+  auto add = [](int&& sum, int v) { return sum + v; };
+  typedef detail::OrderedReduceContext<int, int, decltype(add)> Context;
+  Context* context = new Context(2, 0, add);
+  Future<int> r = context->promise.GetFuture();
+
+  context->Store(1, Try<int>(2));
+  context->Arrive(0, Try<int>(1));
+  ASSERT_TRUE(r.IsReady());
+  ASSERT_EQ(r.Value(), 3);
+
+  context->Announce();
+
+  SetBlockAllocator(previous);
+}
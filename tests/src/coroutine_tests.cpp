@@ -0,0 +1,132 @@
+/******************************************************************************
+ *
+ *  File:   coroutine_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `co_await` on futures and `Task`. Empty
+ *              unless built with coroutine support.
+ *
+ ******************************************************************************/
+
+#include "coroutine.hpp"
+
+#if DIEN_HAS_COROUTINES
+
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+using namespace dien;
+
+namespace
+{
+
+Task<int> AddOne(Future<int> f)
+{
+  Try<int> t = co_await std::move(f);
+  if (t.HasError()) {
+    co_return std::move(t);
+  }
+
+  co_return t.Value() + 1;
+}
+
+Task<int> AddTwo(Future<int> f)
+{
+  Try<int> t = co_await AddOne(std::move(f));
+  if (t.HasError()) {
+    co_return std::move(t);
+  }
+
+  co_return t.Value() + 1;
+}
+
+Task<int> Start(bool& started)
+{
+  started = true;
+  co_return 1;
+}
+
+Task<void> Store(Future<int> f, int& out)
+{
+  Try<int> t = co_await std::move(f);
+  out = t.Value();
+}
+
+}  // namespace
+
+TEST(CoroutineTests, AwaitPendingFuture)
+{
+  Promise<int> promise;
+  Future<int> r = AddOne(promise.GetFuture()).Run();
+  ASSERT_FALSE(r.IsReady());
+
+  promise.SetValue(41);
+  ASSERT_TRUE(r.IsReady());
+  ASSERT_EQ(r.Value(), 42);
+}
+
+TEST(CoroutineTests, AwaitReadyFuture)
+{
+  Future<int> r = AddOne(Future<int>(1)).Run();
+
+  ASSERT_TRUE(r.IsReady());
+  ASSERT_EQ(r.Value(), 2);
+}
+
+TEST(CoroutineTests, ErrorsSurfaceAsTry)
+{
+  Promise<int> promise;
+  Future<int> r = AddTwo(promise.GetFuture()).Run();
+
+  promise.SetError(Error("lookup failed"));
+
+  ASSERT_TRUE(r.HasError());
+}
+
+TEST(CoroutineTests, AwaitTask)
+{
+  Promise<int> promise;
+  Future<int> r = AddTwo(promise.GetFuture()).Run();
+
+  promise.SetValue(1);
+  ASSERT_EQ(r.Value(), 3);
+}
+
+TEST(CoroutineTests, VoidTask)
+{
+  int out = 0;
+  Promise<int> promise;
+  Future<void> r = Store(promise.GetFuture(), out).Run();
+
+  promise.SetValue(7);
+  ASSERT_TRUE(r.IsReady());
+  ASSERT_EQ(out, 7);
+}
+
+TEST(CoroutineTests, ResumesOnFulfillingThread)
+{
+  Promise<int> promise;
+  Future<int> r = AddTwo(promise.GetFuture()).Run();
+
+  std::thread producer([&promise]() { promise.SetValue(10); });
+  producer.join();
+
+  r.Wait();
+  ASSERT_EQ(r.Value(), 12);
+}
+
+TEST(CoroutineTests, LazyUntilRun)
+{
+  bool started = false;
+  Task<int> task = Start(started);
+
+  ASSERT_FALSE(started);
+  Future<int> r = std::move(task).Run();
+  ASSERT_TRUE(started);
+  ASSERT_EQ(r.Value(), 1);
+}
+
+#endif  // DIEN_HAS_COROUTINES
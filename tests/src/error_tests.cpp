@@ -7,13 +7,18 @@
  *
  ******************************************************************************/
 
+#include <string>
+#include <utility>
+
 #include <glog/logging.h>
 
 #include "gtest/gtest.h"
 
+#include "allocation_counter.hpp"
 #include "error.hpp"
 
 using namespace dien;
+using namespace dien::test;
 
 TEST(ErrorTests, NewError)
 {
@@ -48,3 +53,141 @@ TEST(ErrorTests, NestedError)
   }
 }
 
+
+TEST(ErrorTests, FastPathDoesNotAllocate)
+{
+  // Error nodes come from this thread's block pool; fill it first.
+  Error(ErrorCode(kFailed)).Stack(ErrorCode(kFailed));
+
+  AllocationCounter counter;
+
+  Error e(ErrorCode(7, "shard %d unavailable", 3));
+  Error moved(std::move(e));
+  moved.Stack(ErrorCode(kTimedOut));
+  Error assigned = Error(ErrorCode(kFailed));
+  assigned = std::move(moved);
+
+  ASSERT_EQ(counter.Count(), 0u);
+  ASSERT_EQ(assigned.Top().Code(), kTimedOut);
+}
+
+TEST(ErrorTests, LongMessageIsNotTruncated)
+{
+  std::string detail(300, 'x');
+
+  ErrorCode code(1, "detail: %s", detail.c_str());
+
+  ASSERT_EQ(code.Message(), "detail: " + detail);
+  ASSERT_EQ(ErrorCode(code).Message(), "detail: " + detail);
+}
+
+TEST(ErrorTests, InternedMessage)
+{
+  ASSERT_EQ(ErrorCode(kTimedOut).Message(), "timed out");
+
+  InternErrorCode(42, "disk full");
+  ErrorCode code(42);
+  ASSERT_EQ(code.Message(), "disk full");
+  ASSERT_EQ(code.Code(), 42);
+}
+
+TEST(ErrorTests, StaticMessageIsNotCopied)
+{
+  static const char kMessage[] = "backend down";
+
+  ErrorCode code(5, StaticMessage(kMessage));
+
+  ASSERT_EQ(code.MessageData(), kMessage);
+}
+
+TEST(ErrorTests, DeepStackSpillsToHeap)
+{
+  Error e(0, "error 0");
+  for (int i = 1; i < 5; i++) {
+    e.Stack(ErrorCode(i, "error %d", i));
+  }
+
+  Error copy = e;
+  Error::ErrorStack& s = copy;
+
+  ASSERT_EQ(s.size(), 5u);
+  for (int i = 4; i >= 0; i--) {
+    ASSERT_EQ(s.top().Code(), i);
+    ASSERT_EQ(s.top().Message(), "error " + std::to_string(i));
+    s.pop();
+  }
+
+  ASSERT_EQ(e.Top().Code(), 4);
+}
+
+TEST(ErrorTests, DeferredMessageIsFormattedOnDemand)
+{
+  AllocationCounter counter;
+  ErrorCode code(7, kFormatLater, "shard %d of %u at %.1f", 3, 8u, 0.5);
+  ASSERT_EQ(counter.Count(), 0u);
+  ASSERT_EQ(code.Code(), 7);
+
+  ASSERT_EQ(code.Message(), "shard 3 of 8 at 0.5");
+
+  // Formatted once, then cached.
+  const char* text = code.MessageData();
+  ASSERT_EQ(code.MessageData(), text);
+
+  ErrorCode moved(std::move(code));
+  ASSERT_EQ(moved.MessageData(), text);
+
+  ErrorCode copy(moved);
+  ASSERT_EQ(copy.Message(), "shard 3 of 8 at 0.5");
+}
+
+TEST(ErrorTests, DeferredMessageIsNotTruncated)
+{
+  ErrorCode code(1, kFormatLater, "%400d", 5);
+
+  std::string message = code.Message();
+  ASSERT_EQ(message.size(), 400u);
+  ASSERT_EQ(message.back(), '5');
+}
+
+namespace
+{
+
+ErrorCode PortError(int port)
+{
+  std::string fmt = "port %d unavailable";
+  return ErrorCode(5, fmt.c_str(), port);
+}
+
+}  // namespace
+
+TEST(ErrorTests, FormatDoesNotKeepFormat)
+{
+  ErrorCode code = PortError(11);
+
+  ASSERT_EQ(code.Message(), "port 11 unavailable");
+}
+
+TEST(ErrorTests, StackSharesCodesUnderneath)
+{
+  Error base(1, "base");
+
+  Error a = base;
+  a.Stack(ErrorCode(2, "a"));
+
+  Error b(3, "b");
+  b.Stack(base);
+
+  const Error::ErrorStack& s = base;
+  const Error::ErrorStack& sa = a;
+  const Error::ErrorStack& sb = b;
+
+  ASSERT_EQ(s.size(), 1u);
+  ASSERT_EQ(sa.size(), 2u);
+  ASSERT_EQ(sa.top().Code(), 2);
+  ASSERT_EQ(sb.size(), 2u);
+  ASSERT_EQ(sb.top().Code(), 3);
+
+  // Neither copies the base code.
+  ASSERT_EQ(&sa[0], &s.top());
+  ASSERT_EQ(&sb[0], &s.top());
+}
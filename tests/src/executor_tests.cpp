@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ *  File:   executor_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for executors and `Future::Via`.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "future.hpp"
+#include "thread_pool_executor.hpp"
+
+using namespace dien;
+
+TEST(ExecutorTests, InlineExecutor)
+{
+  bool called = false;
+
+  InlineExecutor::Instance().Add([&]() { called = true; });
+
+  ASSERT_TRUE(called);
+}
+
+TEST(ExecutorTests, ThreadPoolRunsEverything)
+{
+  std::atomic<int> count(0);
+
+  {
+    ThreadPoolExecutor pool(4);
+    for (int i = 0; i < 1000; i++) {
+      pool.Add([&]() { count++; });
+    }
+  }
+
+  ASSERT_EQ(count.load(), 1000);
+}
+
+TEST(ExecutorTests, SingleThreadKeepsOrder)
+{
+  std::vector<int> order;
+
+  {
+    SingleThreadExecutor executor;
+    for (int i = 0; i < 100; i++) {
+      executor.Add([&order, i]() { order.push_back(i); });
+    }
+  }
+
+  ASSERT_EQ(order.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(order[i], i);
+  }
+}
+
+TEST(ExecutorTests, ViaRunsContinuationOnExecutor)
+{
+  SingleThreadExecutor executor;
+  std::thread::id executor_thread;
+  executor.Add([&]() { executor_thread = std::this_thread::get_id(); });
+
+  std::thread::id continuation_thread;
+
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+  Future<int> r = f.Via(&executor).Then([&](int v) {
+    continuation_thread = std::this_thread::get_id();
+    return v * 2;
+  });
+
+  promise.SetValue(21);
+
+  while (!r.HasValue()) {
+    std::this_thread::yield();
+  }
+
+  ASSERT_EQ(r.Value(), 42);
+  ASSERT_EQ(continuation_thread, executor_thread);
+  ASSERT_NE(continuation_thread, std::this_thread::get_id());
+}
+
+TEST(ExecutorTests, ThenWithExecutorOnReadyFuture)
+{
+  ThreadPoolExecutor pool(2);
+
+  Future<int> f(5);
+  Future<int> r = f.Then(&pool, [](int v) { return v + 1; });
+
+  while (!r.HasValue()) {
+    std::this_thread::yield();
+  }
+
+  ASSERT_EQ(r.Value(), 6);
+}
@@ -7,13 +7,50 @@
  *
  ******************************************************************************/
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <glog/logging.h>
 
 #include "gtest/gtest.h"
 
+#include "allocation_counter.hpp"
 #include "future.hpp"
 
 using namespace dien;
+using namespace dien::test;
+
+namespace
+{
+
+struct CrossThread
+{
+  int v;
+};
+
+// Compact, with room for bigger continuations.
+struct WideCallback
+{
+  int v;
+};
+
+}  // namespace
+
+namespace dien
+{
+
+template <>
+struct SplitSharedDataLayout<CrossThread> : std::true_type
+{};
+
+template <>
+struct SharedDataCallbackCapacity<WideCallback>
+    : std::integral_constant<size_t, 48>
+{};
+
+}  // namespace dien
 
 TEST(FutureTests, SharedData)
 {
@@ -43,6 +80,68 @@ TEST(FutureTests, SharedDataCallBack)
   ASSERT_TRUE(is_callback_called);
 }
 
+TEST(FutureTests, SharedDataRacingCallbackAndResult)
+{
+  for (int i = 0; i < 1000; i++) {
+    SharedData<int, true> sd;
+    std::atomic<int> calls(0);
+
+    std::thread producer([&]() { sd.SetResult(Try<int>(i)); });
+    sd.SetCallback([&](Try<int>&& data) {
+      ASSERT_EQ(data.Value(), i);
+      calls++;
+    });
+    producer.join();
+
+    ASSERT_TRUE(sd.Ready());
+    ASSERT_EQ(calls.load(), 1);
+  }
+}
+
+TEST(FutureTests, SharedDataDeactivateHoldsCallback)
+{
+  SharedData<int, true> sd;
+  int calls = 0;
+
+  sd.Deactivate();
+  sd.SetCallback([&calls](Try<int>&& data) { calls += data.Value(); });
+  sd.SetResult(Try<int>(5));
+  ASSERT_TRUE(sd.Ready());
+  ASSERT_EQ(calls, 0);
+
+  sd.Activate();
+  ASSERT_EQ(calls, 5);
+  sd.Activate();
+  ASSERT_EQ(calls, 5);
+}
+
+#if DIEN_COUNT_ATOMIC_OPS
+// Callback, result and both detaches: one CAS for each transition and one
+// decrement for each side, whichever comes first.
+TEST(FutureTests, LifetimeAtomicOps)
+{
+  for (bool callback_first : {true, false}) {
+    int value = 0;
+
+    detail::SharedDataAtomicOps() = 0;
+    {
+      Promise<int> promise;
+      Future<int> f = promise.GetFuture();
+      if (!callback_first) {
+        promise.SetValue(3);
+      }
+      f.SetCallback_([&value](Try<int>&& t) { value = t.Value(); });
+      if (callback_first) {
+        promise.SetValue(3);
+      }
+    }
+
+    ASSERT_EQ(value, 3);
+    ASSERT_EQ(detail::SharedDataAtomicOps(), 4u);
+  }
+}
+#endif
+
 #include <cstdlib>
 #include <memory>
 #include <cxxabi.h>
@@ -173,3 +272,414 @@ TEST(FutureTests, OnErrorCallbackWithTry)
   }
 }
 
+TEST(FutureTests, ThenChainCallbacksDoNotAllocate)
+{
+  const int depth = 10;
+  int calls = 0;
+
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+
+  std::vector<Future<int>> chain;
+  chain.reserve(depth);
+
+  // Count every SharedData allocation instead of pool hits.
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+
+  for (int i = 0; i < depth; i++) {
+    Future<int>& last = chain.empty() ? f : chain.back();
+    chain.push_back(last.Then([&calls](int v) {
+      calls++;
+      return v + 1;
+    }));
+  }
+
+  size_t link_allocations = counter.Count();
+
+  AllocationCounter fulfil_counter;
+  promise.SetValue(0);
+  size_t fulfil_allocations = fulfil_counter.Count();
+
+  SetBlockAllocator(previous);
+
+  // Each link allocates only the downstream SharedData: the continuation,
+  // and the Promise it owns, stay inline.
+  ASSERT_EQ(link_allocations, 1u * depth);
+  ASSERT_EQ(fulfil_allocations, 0u);
+  ASSERT_EQ(calls, depth);
+  ASSERT_EQ(chain.back().Value(), depth);
+}
+
+// A continuation capturing a string and a pointer, next to the link's
+// Promise, fills 48 bytes: inline for the split layout, and for a compact
+// type that asks for the room.
+template <class T>
+void CheckCapturingChainDoesNotAllocate()
+{
+  const int depth = 10;
+  std::string name = "shard";
+  int calls = 0;
+
+  Promise<T> promise;
+  Future<T> f = promise.GetFuture();
+
+  std::vector<Future<T>> chain;
+  chain.reserve(depth);
+
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+
+  for (int i = 0; i < depth; i++) {
+    Future<T>& last = chain.empty() ? f : chain.back();
+    chain.push_back(last.Then([name, &calls](T t) {
+      calls++;
+      return T{t.v + static_cast<int>(name.size())};
+    }));
+  }
+
+  size_t link_allocations = counter.Count();
+
+  promise.SetValue(T{0});
+  SetBlockAllocator(previous);
+
+  ASSERT_EQ(link_allocations, 1u * depth);
+  ASSERT_EQ(calls, depth);
+  ASSERT_EQ(chain.back().Value().v, 5 * depth);
+}
+
+TEST(FutureTests, CapturingThenChainDoesNotAllocate)
+{
+  CheckCapturingChainDoesNotAllocate<CrossThread>();
+  CheckCapturingChainDoesNotAllocate<WideCallback>();
+}
+
+TEST(FutureTests, ThenChainWithDroppedFutures)
+{
+  const int depth = 32;
+
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+  Future<int> middle(0);
+
+  for (int i = 0; i < depth; i++) {
+    Future<int> next = f.Then([](int v) { return v + 1; });
+    if (i == depth / 2) {
+      // Keeping one handle makes that state take the slow path.
+      middle = std::move(f);
+    }
+    f = std::move(next);
+  }
+
+  promise.SetValue(0);
+
+  ASSERT_EQ(f.Value(), depth);
+  ASSERT_EQ(middle.Value(), depth / 2);
+
+  Promise<int> failing;
+  f = failing.GetFuture();
+  for (int i = 0; i < depth; i++) {
+    f = f.Then([](int v) { return v + 1; });
+  }
+
+  failing.SetError(Error("upstream failed"));
+  ASSERT_TRUE(f.HasError());
+}
+
+TEST(FutureTests, ThenOnReadyFutureDoesNotAllocate)
+{
+  BlockAllocator* previous = SetBlockAllocator(&MallocAllocator::Instance());
+  AllocationCounter counter;
+
+  Future<int> f(1);
+  Future<int> r = f.Then([](int v) { return v + 1; })
+                      .Then([](Try<int>& t) { return t.Value() * 10; })
+                      .Then([](int v) { return Future<int>(v + 1); });
+
+  size_t allocations = counter.Count();
+  SetBlockAllocator(previous);
+
+  ASSERT_EQ(allocations, 0u);
+  ASSERT_TRUE(r.IsReady());
+  ASSERT_EQ(r.Value(), 21);
+
+  Future<int> failed = Future<int>(FailedFuture(Error("cache miss")))
+                           .Then([](int v) { return v + 1; });
+  ASSERT_TRUE(failed.HasError());
+}
+
+// A ready future hands its result to the first continuation, as a pending
+// one does; using it again is an error, not a moved-from value.
+TEST(FutureTests, ReadyFutureIsConsumedByThen)
+{
+  Future<std::string> f(std::string("hello"));
+  Future<size_t> r = f.Then([](std::string s) { return s.size(); });
+
+  ASSERT_EQ(r.Value(), 5u);
+  ASSERT_FALSE(f.IsReady());
+  ASSERT_DEATH(f.Then([](std::string s) { return s.size(); }), "consumed");
+
+  Future<std::string> g(std::string("hello"));
+  Future<std::string> h = g.Within(std::chrono::seconds(1));
+  ASSERT_EQ(h.Value(), "hello");
+  ASSERT_FALSE(g.IsReady());
+  ASSERT_DEATH(g.Within(std::chrono::seconds(1)), "consumed");
+}
+
+TEST(FutureTests, BrokenPromisePropagatesThroughThen)
+{
+  bool is_continuation_called = false;
+  Future<int> r(0);
+
+  {
+    Promise<int> promise;
+    Future<int> fu = promise.GetFuture();
+
+    r = fu.Then([&](int v) {
+      is_continuation_called = true;
+      return v;
+    });
+  }
+
+  ASSERT_FALSE(is_continuation_called);
+  ASSERT_TRUE(r.HasError());
+}
+
+TEST(FutureTests, CancelRunsInterruptHandler)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+
+  int interrupts = 0;
+  promise.SetInterruptHandler([&](const Error& e) {
+    interrupts++;
+    promise.SetError(e);
+  });
+
+  f.Cancel();
+  f.Cancel();
+
+  ASSERT_EQ(interrupts, 1);
+  ASSERT_TRUE(f.HasError());
+  ASSERT_EQ(f.Get(std::chrono::milliseconds(0)).GetError().Top().Code(),
+            kCancelled);
+}
+
+TEST(FutureTests, CancelBeforeInterruptHandler)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+
+  f.Cancel(Error("no longer needed"));
+
+  std::string message;
+  promise.SetInterruptHandler(
+      [&message](const Error& e) { message = e.Top().Message(); });
+
+  ASSERT_EQ(message, "no longer needed");
+}
+
+TEST(FutureTests, CancelAfterFulfilIsIgnored)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+
+  bool interrupted = false;
+  promise.SetInterruptHandler([&](const Error&) { interrupted = true; });
+  promise.SetValue(1);
+
+  f.Cancel();
+
+  ASSERT_FALSE(interrupted);
+  ASSERT_EQ(f.Value(), 1);
+}
+
+TEST(FutureTests, CancelPropagatesThroughThen)
+{
+  Promise<int> source;
+  Promise<int> inner;
+  Future<int> inner_future = inner.GetFuture();
+
+  int source_interrupts = 0;
+  int inner_interrupts = 0;
+  source.SetInterruptHandler([&](const Error&) { source_interrupts++; });
+  inner.SetInterruptHandler([&](const Error&) { inner_interrupts++; });
+
+  Future<int> r = source.GetFuture()
+                      .Then([](int v) { return v + 1; })
+                      .Then([&](int) { return std::move(inner_future); })
+                      .Then([](int v) { return v * 2; });
+
+  // The chain is waiting on `source`.
+  r.Cancel();
+  ASSERT_EQ(source_interrupts, 1);
+  ASSERT_EQ(inner_interrupts, 0);
+
+  // Once the future-returning link has run, `inner` is what the chain is
+  // waiting on, and it hears about the earlier cancel.
+  source.SetValue(1);
+  ASSERT_EQ(inner_interrupts, 1);
+
+  inner.SetValue(5);
+  ASSERT_EQ(r.Value(), 10);
+}
+
+TEST(FutureTests, CancelRacingFulfil)
+{
+  const int kRounds = 2000;
+
+  for (int i = 0; i < kRounds; i++) {
+    Promise<int> promise;
+    Future<int> f = promise.GetFuture().Then([](int v) { return v; });
+
+    std::atomic<int> interrupts(0);
+    promise.SetInterruptHandler([&](const Error&) { interrupts++; });
+
+    std::thread producer([&promise, i]() { promise.SetValue(i); });
+    f.Cancel();
+    producer.join();
+
+    ASSERT_LE(interrupts.load(), 1);
+    ASSERT_EQ(f.Value(), i);
+  }
+}
+
+TEST(FutureTests, WaitOnReadyFuture)
+{
+  Future<int> f(7);
+
+  f.Wait();
+  ASSERT_TRUE(f.Wait(std::chrono::milliseconds(0)));
+  ASSERT_EQ(f.Get(std::chrono::milliseconds(0)).Value(), 7);
+}
+
+TEST(FutureTests, WaitWakesOnSetValue)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+
+  std::thread producer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    promise.SetValue(11);
+  });
+
+  f.Wait();
+  producer.join();
+
+  ASSERT_TRUE(f.IsReady());
+  ASSERT_EQ(f.Value(), 11);
+}
+
+TEST(FutureTests, WaitTimesOut)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture();
+
+  ASSERT_FALSE(f.Wait(std::chrono::milliseconds(10)));
+
+  Try<int> t = f.Get(std::chrono::milliseconds(10));
+  ASSERT_TRUE(t.HasError());
+  ASSERT_EQ(t.GetError().Top().Code(), kTimedOut);
+
+  promise.SetValue(1);
+  ASSERT_EQ(f.Get(std::chrono::milliseconds(10)).Value(), 1);
+}
+
+TEST(FutureTests, SplitLayout)
+{
+  static_assert(alignof(SharedData<CrossThread>) == kCacheLineSize,
+                "split layout should be line aligned");
+  static_assert(sizeof(SharedData<CrossThread>) == 3 * kCacheLineSize,
+                "split layout should take three lines");
+
+  Promise<CrossThread> promise;
+  Future<int> f =
+      promise.GetFuture().Then([](CrossThread c) { return c.v + 1; });
+
+  std::thread producer([&promise]() { promise.SetValue(CrossThread{6}); });
+  producer.join();
+
+  f.Wait();
+  ASSERT_EQ(f.Value(), 7);
+}
+
+TEST(FutureTests, FulfilBatch)
+{
+  std::vector<Promise<int>> promises(8);
+  std::vector<Future<int>> futures;
+  for (size_t i = 0; i < promises.size(); i++) {
+    if (i % 2) {
+      futures.push_back(promises[i].GetFuture().Then([](int v) { return -v; }));
+    } else {
+      futures.push_back(promises[i].GetFuture());
+    }
+  }
+
+  // Continuations run only once every promise is fulfilled: a later
+  // promise's plain future is ready when the second one's chain runs.
+  bool all_ready = false;
+  futures[1] = futures[1].Then([&futures, &all_ready](int v) {
+    all_ready = futures[6].IsReady();
+    return v;
+  });
+
+  std::vector<int> values = {0, 1, 2, 3, 4, 5, 6, 7};
+  FulfilBatch<int>(promises, values);
+
+  ASSERT_TRUE(all_ready);
+  for (size_t i = 0; i < futures.size(); i++) {
+    int v = static_cast<int>(i);
+    ASSERT_EQ(futures[i].Value(), i % 2 ? -v : v);
+  }
+}
+
+TEST(FutureTests, FulfilBatchChecksItsInput)
+{
+  std::vector<Promise<int>> promises(2);
+  std::vector<int> one = {1};
+  ASSERT_DEATH(FulfilBatch<int>(promises, one), "one value per promise");
+
+  promises[1].SetValue(7);
+  std::vector<int> two = {1, 2};
+  ASSERT_DEATH(FulfilBatch<int>(promises, two), "called twice");
+  ASSERT_DEATH(FailAll<int>(promises, Error("down")), "called twice");
+}
+
+TEST(FutureTests, FailAllOnExecutor)
+{
+  struct QueueExecutor : public Executor
+  {
+    void Add(Func func) override
+    {
+      queue.push_back(std::move(func));
+    }
+
+    std::vector<Func> queue;
+  };
+
+  QueueExecutor executor;
+  std::vector<Future<int>> futures;
+  int failed = 0;
+
+  {
+    std::vector<Promise<int>> promises(4);
+    for (auto& promise : promises) {
+      futures.push_back(promise.GetFuture().OnError([&failed](Error&&) {
+        failed++;
+        return -1;
+      }));
+    }
+
+    FailAll<int>(promises, Error("backend down"), &executor);
+  }
+
+  // The promises are gone; the continuations run in the one task.
+  ASSERT_EQ(failed, 0);
+  ASSERT_EQ(executor.queue.size(), 1u);
+
+  executor.queue[0]();
+  ASSERT_EQ(failed, 4);
+  for (auto& f : futures) {
+    ASSERT_EQ(f.Value(), -1);
+  }
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ *
+ *  File:   inline_function_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `InlineFunction`.
+ *
+ ******************************************************************************/
+
+#include <memory>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "allocation_counter.hpp"
+#include "inline_function.hpp"
+
+using namespace dien;
+using namespace dien::test;
+
+TEST(InlineFunctionTests, Empty)
+{
+  InlineFunction<int()> fn;
+
+  ASSERT_FALSE(fn);
+  ASSERT_FALSE(fn.IsInline());
+}
+
+TEST(InlineFunctionTests, SmallCallableStaysInline)
+{
+  int a = 1;
+  int b = 2;
+
+  AllocationCounter counter;
+  InlineFunction<int(int)> fn = [a, b](int c) { return a + b + c; };
+
+  ASSERT_TRUE(fn.IsInline());
+  ASSERT_EQ(fn(3), 6);
+  ASSERT_EQ(counter.Count(), 0u);
+}
+
+TEST(InlineFunctionTests, LargeCallableFallsBackToHeap)
+{
+  char big[kInlineFunctionCapacity + 1] = {7};
+
+  InlineFunction<int()> fn = [big]() { return big[0]; };
+
+  ASSERT_TRUE(fn);
+  ASSERT_FALSE(fn.IsInline());
+  ASSERT_EQ(fn(), 7);
+}
+
+TEST(InlineFunctionTests, MoveOnlyCapture)
+{
+  std::unique_ptr<int> value(new int(42));
+
+  InlineFunction<int()> fn = [v = std::move(value)]() { return *v; };
+  InlineFunction<int()> moved(std::move(fn));
+
+  ASSERT_FALSE(fn);
+  ASSERT_TRUE(moved.IsInline());
+  ASSERT_EQ(moved(), 42);
+}
+
+TEST(InlineFunctionTests, DestroysCallable)
+{
+  std::shared_ptr<int> value = std::make_shared<int>(1);
+
+  {
+    InlineFunction<void()> fn = [value]() {};
+    ASSERT_EQ(value.use_count(), 2);
+
+    fn = nullptr;
+    ASSERT_EQ(value.use_count(), 1);
+  }
+
+  ASSERT_EQ(value.use_count(), 1);
+}
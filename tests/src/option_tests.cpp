@@ -7,6 +7,8 @@
  *
  ******************************************************************************/
 
+#include <memory>
+
 #include <glog/logging.h>
 
 #include "gtest/gtest.h"
@@ -110,3 +112,13 @@ TEST(OpionTests, TryError)
 
   ASSERT_EQ(v.GetError().Top().Message(), "test error");
 }
+
+TEST(OptionTests, AssignmentMovesValue)
+{
+  Option<std::unique_ptr<int>> o;
+  o = std::unique_ptr<int>(new int(3));
+
+  Option<std::unique_ptr<int>> moved(std::move(o));
+  ASSERT_FALSE(o.HasValue());
+  ASSERT_EQ(*moved.Value(), 3);
+}
@@ -0,0 +1,137 @@
+/******************************************************************************
+ *
+ *  File:   parallel_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `ParallelFor`, `ParallelMap` and
+ *              `ParallelReduce`.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "parallel.hpp"
+#include "thread_pool_executor.hpp"
+#include "work_stealing_executor.hpp"
+
+using namespace dien;
+
+TEST(ParallelTests, ForVisitsEveryIndexOnce)
+{
+  const size_t kCount = 100000;
+  std::vector<std::atomic<int>> seen(kCount);
+
+  ThreadPoolExecutor pool(4);
+  Future<void> f = ParallelFor(pool, 0, kCount, 64, [&seen](size_t i) {
+    seen[i]++;
+  });
+
+  f.Wait();
+  ASSERT_FALSE(f.HasError());
+  for (size_t i = 0; i < kCount; i++) {
+    ASSERT_EQ(seen[i].load(), 1);
+  }
+}
+
+TEST(ParallelTests, ForEmptyRange)
+{
+  ThreadPoolExecutor pool(2);
+  Future<void> f = ParallelFor(pool, 5, 5, 1, [](size_t) {});
+
+  ASSERT_TRUE(f.IsReady());
+}
+
+TEST(ParallelTests, ForReportsError)
+{
+  std::atomic<size_t> calls(0);
+
+  WorkStealingExecutor executor(4);
+  Future<void> f =
+      ParallelFor(executor, 0, 1000000, 16, [&calls](size_t i) -> Try<void> {
+        calls++;
+        if (i == 100) {
+          return Try<void>(Error("bad index"));
+        }
+        return Try<void>();
+      });
+
+  f.Wait();
+  ASSERT_TRUE(f.HasError());
+  ASSERT_LT(calls.load(), 1000000u);
+}
+
+TEST(ParallelTests, MapKeepsOrder)
+{
+  std::vector<int> input;
+  for (int i = 0; i < 10000; i++) {
+    input.push_back(i);
+  }
+
+  ThreadPoolExecutor pool(3);
+  Future<std::vector<std::string>> f = ParallelMap(
+      pool, std::move(input), 100, [](int& v) { return std::to_string(v); });
+
+  f.Wait();
+  std::vector<std::string>& output = f.Value();
+  ASSERT_EQ(output.size(), 10000u);
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_EQ(output[i], std::to_string(i));
+  }
+}
+
+// Neighbouring chunks land in the same word of a `std::vector<bool>`.
+TEST(ParallelTests, MapToBool)
+{
+  std::vector<int> input;
+  for (int i = 0; i < 10000; i++) {
+    input.push_back(i);
+  }
+
+  WorkStealingExecutor executor(4);
+  Future<std::vector<bool>> f = ParallelMap(
+      executor, std::move(input), 3, [](int& v) { return v % 3 == 0; });
+
+  f.Wait();
+  std::vector<bool>& output = f.Value();
+  ASSERT_EQ(output.size(), 10000u);
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_EQ(output[i], i % 3 == 0);
+  }
+}
+
+TEST(ParallelTests, ReduceSums)
+{
+  const size_t kCount = 1000000;
+
+  WorkStealingExecutor executor(4);
+  Future<long> f = ParallelReduce(
+      executor, 0, kCount, 1024, 0L,
+      [](long&& sum, size_t i) { return sum + static_cast<long>(i); },
+      [](long&& a, long&& b) { return a + b; });
+
+  f.Wait();
+  ASSERT_EQ(f.Value(), static_cast<long>(kCount) * (kCount - 1) / 2);
+}
+
+TEST(ParallelTests, ReduceReportsError)
+{
+  ThreadPoolExecutor pool(2);
+  Future<int> f = ParallelReduce(
+      pool, 0, 100, 1, 0,
+      [](int&& count, size_t i) -> Try<int> {
+        if (i == 42) {
+          return Try<int>(Error("no 42"));
+        }
+        return Try<int>(count + 1);
+      },
+      [](int&& a, int&& b) { return a + b; });
+
+  f.Wait();
+  ASSERT_TRUE(f.HasError());
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ *
+ *  File:   scoped_lock_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `SpinLock` and its waiting policies.
+ *
+ ******************************************************************************/
+
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "scoped_lock.hpp"
+
+using namespace dien;
+
+template <class Policy>
+static void CheckMutualExclusion()
+{
+  SpinLock<Policy> lock;
+  long counter = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 10000; j++) {
+        ScopedLock<Policy> guard(lock);
+        counter++;
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(counter, 80000);
+}
+
+TEST(ScopedLockTests, TryLock)
+{
+  SpinLock<> lock;
+
+  ASSERT_TRUE(lock.TryLock());
+  ASSERT_FALSE(lock.TryLock());
+
+  lock.Unlock();
+  ASSERT_TRUE(lock.TryLock());
+  lock.Unlock();
+}
+
+TEST(ScopedLockTests, SpinPolicy)
+{
+  CheckMutualExclusion<SpinPolicy>();
+}
+
+TEST(ScopedLockTests, YieldPolicy)
+{
+  CheckMutualExclusion<YieldPolicy>();
+}
+
+TEST(ScopedLockTests, ParkPolicy)
+{
+  CheckMutualExclusion<ParkPolicy>();
+}
@@ -0,0 +1,175 @@
+/******************************************************************************
+ *
+ *  File:   shared_future_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `SharedFuture`.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "shared_future.hpp"
+
+using namespace dien;
+
+namespace
+{
+
+// Counts copies, to show the consumers share one result.
+struct Tracked
+{
+  explicit Tracked(int v) : value(v)
+  {
+  }
+
+  Tracked(const Tracked& other) : value(other.value)
+  {
+    copies++;
+  }
+
+  Tracked(Tracked&& other) noexcept : value(other.value)
+  {
+  }
+
+  int value;
+  static int copies;
+};
+
+int Tracked::copies = 0;
+
+}  // namespace
+
+TEST(SharedFutureTests, ManyConsumers)
+{
+  Promise<Tracked> promise;
+  SharedFuture<Tracked> shared(promise.GetFuture());
+
+  std::vector<Future<int>> results;
+  for (int i = 0; i < 100; i++) {
+    results.push_back(shared.Then([i](const Tracked& t) { return t.value + i; }));
+  }
+  ASSERT_FALSE(shared.IsReady());
+
+  Tracked::copies = 0;
+  promise.SetValue(Tracked(1));
+
+  ASSERT_TRUE(shared.IsReady());
+  ASSERT_EQ(Tracked::copies, 0);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(results[i].Value(), i + 1);
+  }
+}
+
+TEST(SharedFutureTests, RunsInOrderAdded)
+{
+  Promise<int> promise;
+  SharedFuture<int> shared(promise.GetFuture());
+
+  std::vector<int> order;
+  for (int i = 0; i < 5; i++) {
+    shared.SetCallback([&order, i](const Try<int>&) { order.push_back(i); });
+  }
+
+  promise.SetValue(0);
+  ASSERT_EQ(order, std::vector<int>({0, 1, 2, 3, 4}));
+}
+
+TEST(SharedFutureTests, ThenOnReady)
+{
+  SharedFuture<std::string> shared(Future<std::string>(std::string("ready")));
+  ASSERT_TRUE(shared.IsReady());
+
+  Future<size_t> f = shared.Then([](const std::string& s) { return s.size(); });
+  ASSERT_TRUE(f.IsReady());
+  ASSERT_EQ(f.Value(), 5u);
+
+  ASSERT_EQ(shared.GetFuture().Value(), "ready");
+  ASSERT_EQ(shared.Result().Value(), "ready");
+}
+
+TEST(SharedFutureTests, ErrorsReachEveryConsumer)
+{
+  Promise<int> promise;
+  SharedFuture<int> shared(promise.GetFuture());
+
+  Future<int> a = shared.Then([](const int& v) { return v; });
+  Future<int> b = shared.GetFuture();
+
+  promise.SetError(Error("backend down"));
+
+  ASSERT_TRUE(shared.HasError());
+  ASSERT_TRUE(a.HasError());
+  ASSERT_TRUE(b.HasError());
+}
+
+TEST(SharedFutureTests, VoidAndCopies)
+{
+  Promise<void> promise;
+  SharedFuture<void> shared(promise.GetFuture());
+  SharedFuture<void> copy = shared;
+
+  int calls = 0;
+  Future<void> a = shared.Then([&calls]() { calls++; });
+  Future<void> b = copy.Then([&calls]() { calls++; });
+
+  promise.SetWith([]() {});
+
+  ASSERT_TRUE(copy.IsReady());
+  ASSERT_TRUE(a.IsReady());
+  ASSERT_TRUE(b.IsReady());
+  ASSERT_EQ(calls, 2);
+}
+
+TEST(SharedFutureTests, OutlivesHandles)
+{
+  Promise<int> promise;
+  Future<int> f(0);
+
+  {
+    SharedFuture<int> shared(promise.GetFuture());
+    f = shared.Then([](const int& v) { return v * 2; });
+  }
+
+  promise.SetValue(21);
+  ASSERT_EQ(f.Value(), 42);
+}
+
+TEST(SharedFutureTests, ConsumersRacingFulfil)
+{
+  const int kConsumers = 4;
+  const int kEach = 1000;
+
+  for (int round = 0; round < 20; round++) {
+    Promise<int> promise;
+    SharedFuture<int> shared(promise.GetFuture());
+    std::atomic<int> calls(0);
+
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < kConsumers; i++) {
+      consumers.emplace_back([shared, &calls]() mutable {
+        for (int j = 0; j < kEach; j++) {
+          shared.SetCallback([&calls](const Try<int>& t) {
+            if (t.Value() == 7) {
+              calls++;
+            }
+          });
+        }
+      });
+    }
+
+    promise.SetValue(7);
+    for (auto& consumer : consumers) {
+      consumer.join();
+    }
+
+    ASSERT_EQ(calls.load(), kConsumers * kEach);
+  }
+}
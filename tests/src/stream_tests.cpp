@@ -0,0 +1,198 @@
+/******************************************************************************
+ *
+ *  File:   stream_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `Stream` and `StreamWriter`.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "stream.hpp"
+#include "thread_pool_executor.hpp"
+
+using namespace dien;
+
+TEST(StreamTests, DeliversInOrder)
+{
+  StreamWriter<int> writer;
+  std::vector<int> seen;
+
+  Future<void> done =
+      writer.GetStream().ForEach([&seen](int v) { seen.push_back(v); });
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(writer.Write(i).IsReady());
+  }
+  ASSERT_FALSE(done.IsReady());
+
+  writer.Close();
+
+  ASSERT_TRUE(done.IsReady());
+  ASSERT_FALSE(done.HasError());
+  ASSERT_EQ(seen, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(StreamTests, BuffersUntilConsumed)
+{
+  StreamWriter<int> writer;
+  Stream<int> stream = writer.GetStream();
+
+  writer.Write(1);
+  writer.Write(std::vector<int>({2, 3}));
+  writer.Close();
+
+  std::vector<size_t> batches;
+  Future<void> done = stream.ForEachBatch(
+      [&batches](std::vector<int>& batch) { batches.push_back(batch.size()); });
+
+  ASSERT_TRUE(done.IsReady());
+  ASSERT_EQ(batches, std::vector<size_t>({3}));
+}
+
+TEST(StreamTests, Combinators)
+{
+  StreamWriter<int> writer;
+  std::vector<std::vector<std::string>> seen;
+
+  Future<void> done = writer.GetStream()
+                          .Filter([](const int& v) { return v % 2 == 0; })
+                          .Map([](int v) { return std::to_string(v); })
+                          .Batch(3)
+                          .ForEach([&seen](std::vector<std::string> group) {
+                            seen.push_back(std::move(group));
+                          });
+
+  for (int i = 0; i < 10; i++) {
+    writer.Write(i);
+  }
+  writer.Close();
+
+  ASSERT_TRUE(done.IsReady());
+  ASSERT_EQ(seen.size(), 2u);
+  ASSERT_EQ(seen[0], std::vector<std::string>({"0", "2", "4"}));
+  ASSERT_EQ(seen[1], std::vector<std::string>({"6", "8"}));
+}
+
+TEST(StreamTests, TakeStopsTheWriter)
+{
+  StreamWriter<int> writer;
+  std::vector<int> seen;
+
+  Future<void> done = writer.GetStream().Take(3).ForEach(
+      [&seen](int v) { seen.push_back(v); });
+
+  writer.Write(std::vector<int>({1, 2}));
+  ASSERT_FALSE(done.IsReady());
+  ASSERT_FALSE(writer.IsCancelled());
+
+  writer.Write(std::vector<int>({3, 4, 5}));
+  ASSERT_TRUE(done.IsReady());
+  ASSERT_FALSE(done.HasError());
+  ASSERT_TRUE(writer.IsCancelled());
+
+  ASSERT_TRUE(writer.Write(6).HasError());
+  ASSERT_EQ(seen, std::vector<int>({1, 2, 3}));
+}
+
+TEST(StreamTests, Backpressure)
+{
+  StreamWriter<int> writer(2);
+  Stream<int> stream = writer.GetStream();
+
+  ASSERT_TRUE(writer.Write(1).IsReady());
+  Future<void> room = writer.Write(2);
+  ASSERT_FALSE(room.IsReady());
+
+  int sum = 0;
+  Future<void> done = stream.ForEach([&sum](int v) { sum += v; });
+
+  ASSERT_TRUE(room.IsReady());
+  ASSERT_FALSE(room.HasError());
+  ASSERT_EQ(sum, 3);
+
+  writer.Close();
+  ASSERT_TRUE(done.IsReady());
+}
+
+TEST(StreamTests, FailEndsWithError)
+{
+  StreamWriter<int> writer;
+  int count = 0;
+
+  Future<void> done =
+      writer.GetStream().Map([](int v) { return v; }).ForEach([&count](int) {
+        count++;
+      });
+
+  writer.Write(1);
+  writer.Fail(Error("disk gone"));
+
+  ASSERT_TRUE(done.HasError());
+  ASSERT_EQ(count, 1);
+}
+
+TEST(StreamTests, DroppedWriterBreaksTheStream)
+{
+  Future<void> done(FailedFuture(Error("unset")));
+
+  {
+    StreamWriter<int> writer;
+    done = writer.GetStream().ForEach([](int) {});
+    writer.Write(1);
+  }
+
+  ASSERT_TRUE(done.HasError());
+}
+
+TEST(StreamTests, DroppedStreamCancelsTheWriter)
+{
+  StreamWriter<int> writer;
+  {
+    Stream<int> stream = writer.GetStream();
+  }
+
+  ASSERT_TRUE(writer.IsCancelled());
+  ASSERT_TRUE(writer.Write(1).HasError());
+}
+
+TEST(StreamTests, ViaBatchesDeliveries)
+{
+  const int kCount = 10000;
+
+  std::atomic<int> batches(0);
+  long sum = 0;
+  Future<void> done;
+
+  {
+    SingleThreadExecutor executor;
+    StreamWriter<int> writer;
+
+    done = writer.GetStream().Via(&executor).ForEachBatch(
+        [&](std::vector<int>& batch) {
+          batches++;
+          for (int v : batch) {
+            sum += v;
+          }
+        });
+
+    for (int i = 0; i < kCount; i++) {
+      writer.Write(i);
+    }
+    writer.Close();
+
+    done.Wait();
+  }
+
+  ASSERT_FALSE(done.HasError());
+  ASSERT_EQ(sum, static_cast<long>(kCount) * (kCount - 1) / 2);
+  ASSERT_LE(batches.load(), kCount);
+}
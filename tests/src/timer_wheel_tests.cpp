@@ -0,0 +1,177 @@
+/******************************************************************************
+ *
+ *  File:   timer_wheel_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `TimerWheel`, `Sleep` and `Future::Within`.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "future.hpp"
+#include "timer_wheel.hpp"
+
+using namespace dien;
+
+typedef std::chrono::steady_clock Clock;
+
+TEST(TimerWheelTests, FiresAfterDelay)
+{
+  TimerWheel wheel;
+  Promise<Clock::time_point> fired;
+  Future<Clock::time_point> f = fired.GetFuture();
+
+  auto start = Clock::now();
+  wheel.Add(std::chrono::milliseconds(20),
+            [&]() { fired.SetValue(Clock::now()); });
+
+  f.Wait();
+  ASSERT_GE(f.Value() - start, std::chrono::milliseconds(20));
+}
+
+TEST(TimerWheelTests, FiresInDeadlineOrder)
+{
+  // Delays on both sides of a level-0 turn, so some timers cascade.
+  const int delays[] = {300, 5, 270, 40, 0, 120};
+
+  std::mutex mutex;
+  std::vector<int> order;
+  std::atomic<int> remaining(6);
+
+  TimerWheel wheel;
+  for (int delay : delays) {
+    wheel.Add(std::chrono::milliseconds(delay), [&, delay]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(delay);
+      remaining--;
+    });
+  }
+
+  while (remaining.load() != 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::vector<int> expected = {0, 5, 40, 120, 270, 300};
+  ASSERT_EQ(order, expected);
+}
+
+TEST(TimerWheelTests, CancelledTimerDoesNotFire)
+{
+  std::atomic<bool> fired(false);
+
+  {
+    TimerWheel wheel;
+    Timer timer =
+        wheel.Add(std::chrono::milliseconds(10), [&]() { fired = true; });
+
+    ASSERT_TRUE(timer.Cancel());
+    ASSERT_FALSE(timer.Cancel());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  }
+
+  ASSERT_FALSE(fired.load());
+}
+
+TEST(TimerWheelTests, PendingTimersDroppedOnDestruction)
+{
+  Future<void> f = []() {
+    TimerWheel wheel;
+    Promise<void> p;
+    Future<void> f = p.GetFuture();
+    wheel.Add(std::chrono::seconds(60),
+              [pm = std::move(p)]() mutable { pm.SetWith([]() {}); });
+    return f;
+  }();
+
+  ASSERT_TRUE(f.IsReady());
+  ASSERT_TRUE(f.HasError());
+}
+
+TEST(TimerWheelTests, Sleep)
+{
+  auto start = Clock::now();
+
+  Future<void> f = Sleep(std::chrono::milliseconds(20));
+  f.Wait();
+
+  ASSERT_FALSE(f.HasError());
+  ASSERT_GE(Clock::now() - start, std::chrono::milliseconds(20));
+}
+
+TEST(TimerWheelTests, WithinTimesOut)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture().Within(std::chrono::milliseconds(10));
+
+  f.Wait();
+  ASSERT_TRUE(f.HasError());
+  ASSERT_EQ(f.Get(std::chrono::seconds(0)).GetError().Top().Code(),
+            kTimedOut);
+
+  // Late results are dropped.
+  promise.SetValue(1);
+}
+
+TEST(TimerWheelTests, WithinResultWins)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture().Within(std::chrono::seconds(60));
+
+  promise.SetValue(42);
+
+  ASSERT_TRUE(f.IsReady());
+  ASSERT_EQ(f.Value(), 42);
+}
+
+TEST(TimerWheelTests, WithinCustomError)
+{
+  Promise<int> promise;
+  Future<int> f = promise.GetFuture().Within(std::chrono::milliseconds(1),
+                                             Error(ErrorCode(7, "rpc")));
+
+  f.Wait();
+  ASSERT_EQ(f.Get(std::chrono::seconds(0)).GetError().Top().Code(), 7);
+}
+
+TEST(TimerWheelTests, WithinCancelReachesProducer)
+{
+  Promise<int> promise;
+  int interrupted = -1;
+  promise.SetInterruptHandler(
+      [&interrupted](const Error& e) { interrupted = e.Top().Code(); });
+
+  Future<int> f = promise.GetFuture().Within(std::chrono::seconds(60));
+  f.Cancel();
+
+  ASSERT_EQ(interrupted, kCancelled);
+  promise.SetValue(1);
+}
+
+// The producer hears the timeout, and may stop its work, even though nobody
+// holds the future it fulfils any more.
+TEST(TimerWheelTests, WithinTimeoutInterruptsProducer)
+{
+  Promise<int> promise;
+  int interrupted = -1;
+  promise.SetInterruptHandler([&promise, &interrupted](const Error& e) {
+    interrupted = e.Top().Code();
+    promise.SetError(e);
+  });
+
+  Future<int> f = promise.GetFuture().Within(std::chrono::milliseconds(5));
+
+  f.Wait();
+  ASSERT_EQ(f.Get(std::chrono::seconds(0)).GetError().Top().Code(),
+            kTimedOut);
+  ASSERT_EQ(interrupted, kTimedOut);
+}
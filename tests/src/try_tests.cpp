@@ -43,3 +43,24 @@ TEST(TryTests, Error)
   ASSERT_EQ(stack.top().Code(), -1);
 }
 
+
+TEST(TryTests, VoidErrorSurvivesMove)
+{
+  Try<void> t(Error(-1, "test error"));
+
+  Try<void> moved(std::move(t));
+  ASSERT_TRUE(moved.HasError());
+
+  Try<void> assigned;
+  assigned = std::move(moved);
+  ASSERT_TRUE(assigned.HasError());
+  ASSERT_EQ(assigned.GetError().Top().Code(), -1);
+}
+
+TEST(TryTests, VoidEmptyErrorIsStillAnError)
+{
+  Try<void> t{Error(Error::ErrorStack())};
+
+  ASSERT_TRUE(t.HasError());
+  ASSERT_EQ(t.GetError().Top().Code(), kFailed);
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+ *
+ *  File:   work_stealing_executor_tests.cpp
+ *  Author: Jojy G Varghese
+ *
+ *  Description: Test suite for `ChaseLevDeque` and `WorkStealingExecutor`.
+ *
+ ******************************************************************************/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "gtest/gtest.h"
+
+#include "chase_lev_deque.hpp"
+#include "future.hpp"
+#include "work_stealing_executor.hpp"
+
+using namespace dien;
+
+TEST(WorkStealingTests, DequeOwnerIsLifoThiefIsFifo)
+{
+  ChaseLevDeque<intptr_t> deque(2);
+
+  for (intptr_t i = 0; i < 10; i++) {
+    deque.Push(i);
+  }
+
+  intptr_t value = -1;
+  ASSERT_TRUE(deque.Pop(value));
+  ASSERT_EQ(value, 9);
+
+  ASSERT_TRUE(deque.Steal(value));
+  ASSERT_EQ(value, 0);
+}
+
+TEST(WorkStealingTests, DequeEveryElementTakenOnce)
+{
+  const intptr_t count = 100000;
+  ChaseLevDeque<intptr_t> deque;
+  std::vector<std::atomic<int>> seen(count);
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 3; i++) {
+    thieves.emplace_back([&]() {
+      intptr_t value;
+      while (!done.load() || !deque.Empty()) {
+        if (deque.Steal(value)) {
+          seen[value]++;
+        }
+      }
+    });
+  }
+
+  intptr_t value;
+  for (intptr_t i = 0; i < count; i++) {
+    deque.Push(i);
+    if (i % 3 == 0 && deque.Pop(value)) {
+      seen[value]++;
+    }
+  }
+
+  while (deque.Pop(value)) {
+    seen[value]++;
+  }
+
+  done.store(true);
+  for (auto& thief : thieves) {
+    thief.join();
+  }
+
+  for (intptr_t i = 0; i < count; i++) {
+    ASSERT_EQ(seen[i].load(), 1) << "element " << i;
+  }
+}
+
+TEST(WorkStealingTests, RunsNestedTasks)
+{
+  std::atomic<int> count(0);
+
+  {
+    WorkStealingExecutor executor(4);
+
+    for (int i = 0; i < 100; i++) {
+      executor.Add([&]() {
+        for (int j = 0; j < 100; j++) {
+          executor.Add([&]() { count++; });
+        }
+      });
+    }
+  }
+
+  ASSERT_EQ(count.load(), 10000);
+}
+
+TEST(WorkStealingTests, ThenViaWorkStealingExecutor)
+{
+  WorkStealingExecutor executor(2);
+  std::atomic<int> sum(0);
+
+  std::vector<Promise<int>> promises(100);
+  std::vector<Future<void>> results;
+  for (auto& promise : promises) {
+    results.push_back(promise.GetFuture().Then(&executor, [&](int v) {
+      sum += v;
+    }));
+  }
+
+  for (int i = 0; i < 100; i++) {
+    promises[i].SetValue(i);
+  }
+
+  while (sum.load() != 4950) {
+    std::this_thread::yield();
+  }
+}